@@ -102,6 +102,15 @@ extern const uint8_t digital_pin_to_timer[];
 #define TIMERB2 4
 #define TIMERB3 5
 
+// A library or sketch that defines its own TCBn interrupt claims the timer
+// at file scope with TCB_CLAIM(n), so tone() leaves it alone and its TCBn
+// interrupt isn't linked
+#ifdef __cplusplus
+#define TCB_CLAIM(n) extern "C" const uint8_t tcb##n##_claimed = 1
+#else
+#define TCB_CLAIM(n) const uint8_t tcb##n##_claimed = 1
+#endif
+
 void setup_timers();
 
 #define digitalPinToPort(pin) ( (pin < NUM_TOTAL_PINS) ? digital_pin_to_port[pin] : NOT_A_PIN )
@@ -120,6 +129,20 @@ void setup_timers();
 #define portInputRegister(P) ( (volatile uint8_t *)( &portToPortStruct(P)->IN ) )
 #define portModeRegister(P) ( (volatile uint8_t *)( &portToPortStruct(P)->DIR ) )
 
+// Parallel port access. port is PA..PF, and only the bits set in mask are affected.
+// portWrite() updates all masked bits with a single write to the OUT register
+void portWrite(uint8_t port, uint8_t mask, uint8_t value);
+uint8_t portRead(uint8_t port, uint8_t mask);
+void portSet(uint8_t port, uint8_t mask);
+void portClear(uint8_t port, uint8_t mask);
+void portToggle(uint8_t port, uint8_t mask);
+void portMode(uint8_t port, uint8_t mask, uint8_t mode);
+
+// Shift a buffer of bytes in or out, buf[0] first. Uses SPI0 or a USART in
+// master SPI mode when the pins match a peripheral pin route
+void shiftOutBuffer(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, const uint8_t *buf, size_t len);
+void shiftInBuffer(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t *buf, size_t len);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -150,9 +173,20 @@ enum timers_prescaler_t : uint8_t {
   TCB_CLKTCA  = 0x40,
 };
 
+enum tca_mode_t : uint8_t {
+  TCA_SPLIT_MODE  = 0x00, // Six 8-bit PWM channels, TCA0_0..TCA0_5 (default)
+  TCA_SINGLE_MODE = 0x01, // Three 16-bit PWM channels, TCA0_0..TCA0_2
+};
+
 void pwmWrite(pwm_timers_t pwmTimer, uint16_t value, timers_route_t timerRoute = ROUTE_UNTOUCHED);
 void pwmPrescaler(pwm_timers_t pwmTimer, timers_prescaler_t prescaler);
-void pwmSetResolution(pwm_timers_t pwmTimer, uint8_t maxValue);
+void pwmSetResolution(pwm_timers_t pwmTimer, uint16_t maxValue);
+void pwmSetMode(tca_mode_t mode);
+void pwmUpdateBegin();
+void pwmUpdateEnd();
+// Called from the TCA0 overflow interrupt while TCA0 is in single mode. The
+// vector is shared with pwmUpdateEnd(), which uses it in split mode
+void pwmAttachOverflow(void (*callback)(void));
 
 // These are used as the second to N argument to pinConfigure(pin, ...)
 // Directives are handled in the order they show up on this list, by pin function:
@@ -337,7 +371,461 @@ void pinConfigure(const uint8_t digital_pin, const pin_configure_t mode, const M
   SREG = oldSREG;
 }
 
+/**
+ * @brief Pin handle for pins that are only known at runtime. The port and bit
+ * mask are looked up once in the constructor, and the access methods compile
+ * down to a single store or load through the cached port pointer. Writes use
+ * the OUTSET/OUTCLR/OUTTGL registers, so they are interrupt safe.
+ * Unlike digitalWrite(), PWM is NOT turned off on the pin.
+ * An invalid pin results in a handle where writes do nothing and reads return LOW.
+ */
+class FastPin
+{
+  public:
+    /**
+     * @brief Construct a new pin handle
+     *
+     * @param digital_pin Arduino pin number
+     */
+    FastPin(const uint8_t digital_pin)
+    {
+      _bit_mask = digitalPinToBitMask(digital_pin);
+      if(_bit_mask == NOT_A_PIN)
+      {
+        _bit_mask = 0;
+        _port = &PORTA;
+      }
+      else
+        _port = digitalPinToPortStruct(digital_pin);
+    }
+
+    /**
+     * @brief Drive the pin high
+     */
+    inline __attribute__((always_inline)) void set() { _port->OUTSET = _bit_mask; }
+
+    /**
+     * @brief Drive the pin low
+     */
+    inline __attribute__((always_inline)) void clear() { _port->OUTCLR = _bit_mask; }
+
+    /**
+     * @brief Toggle the pin output
+     */
+    inline __attribute__((always_inline)) void toggle() { _port->OUTTGL = _bit_mask; }
+
+    /**
+     * @brief Write HIGH, LOW or CHANGE to the pin output
+     *
+     * @param state HIGH, LOW or CHANGE
+     */
+    inline __attribute__((always_inline)) void write(const uint8_t state)
+    {
+      if(state == LOW)
+        clear();
+      else if(state == CHANGE)
+        toggle();
+      else
+        set();
+    }
+
+    /**
+     * @brief Read the pin input
+     *
+     * @return uint8_t HIGH or LOW
+     */
+    inline __attribute__((always_inline)) uint8_t read() const { return !!(_port->IN & _bit_mask); }
+
+    /**
+     * @brief Set the pin direction to output
+     */
+    inline __attribute__((always_inline)) void output() { _port->DIRSET = _bit_mask; }
+
+    /**
+     * @brief Set the pin direction to input. Pullup settings are left untouched
+     */
+    inline __attribute__((always_inline)) void input() { _port->DIRCLR = _bit_mask; }
+
+    /**
+     * @brief Check if the handle refers to a valid pin
+     *
+     * @return true if the pin passed to the constructor exists
+     */
+    inline bool isValid() const { return _bit_mask != 0; }
+
+    /**
+     * @brief Get the bit mask of the pin within its port
+     *
+     * @return uint8_t bit mask
+     */
+    inline uint8_t bitMask() const { return _bit_mask; }
+
+    /**
+     * @brief Get the port the pin belongs to
+     *
+     * @return PORT_t* pointer to the PORT register struct
+     */
+    inline PORT_t *port() const { return _port; }
+
+  private:
+    PORT_t *_port;
+    uint8_t _bit_mask;
+};
+
+#ifndef PIN_GROUP_MAX_PINS
+#define PIN_GROUP_MAX_PINS 16
+#endif
+
+/**
+ * @brief A group of up to PIN_GROUP_MAX_PINS arbitrary pins that are written
+ * and read as one value, where the first pin in the list is bit 0.
+ * The pin list is split into per-port masks in the constructor, so write()
+ * only does one OUT register write per port involved, and all pins on the same
+ * port change simultaneously. Useful for parallel LCD buses and stepper patterns.
+ */
+class PinGroup
+{
+  public:
+    PinGroup(const uint8_t *pins, uint8_t count);
+    void write(uint16_t value);
+    uint16_t read();
+    void mode(uint8_t mode);
+    inline uint8_t count() const { return _count; }
+    inline uint8_t portMask(uint8_t port) const { return (port < NUM_TOTAL_PORTS) ? _port_mask[port] : 0; }
+
+  private:
+    uint8_t _count;
+    uint8_t _port[PIN_GROUP_MAX_PINS];
+    uint8_t _bit_mask[PIN_GROUP_MAX_PINS];
+    uint8_t _port_mask[NUM_TOTAL_PORTS];
+};
+
+inline void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, const uint8_t *buf, size_t len)
+{
+  shiftOutBuffer(dataPin, clockPin, bitOrder, buf, len);
+}
+
+inline void shiftIn(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t *buf, size_t len)
+{
+  shiftInBuffer(dataPin, clockPin, bitOrder, buf, len);
+}
+
 #endif
 
 #include "pins_arduino.h"
+
+/*
+ * Compile time pin lookup, built from the PIN_Pxn macros in pins_arduino.h.
+ * These fold to a constant when the pin number is known at compile time, which
+ * the digital_pin_to_* tables can't do since they're only extern'd here.
+ * Returns NOT_A_PIN / NOT_A_PORT for pins that doesn't exist.
+ */
+#ifdef __cplusplus
+  #define PIN_CONSTEXPR constexpr __attribute__((always_inline))
+#else
+  #define PIN_CONSTEXPR static inline __attribute__((always_inline))
+#endif
+
+PIN_CONSTEXPR uint8_t digitalPinToPortBitConst(uint8_t pin)
+{
+#ifdef PIN_PA0
+  if(pin == PIN_PA0) return (PA << 3) | 0;
+#endif
+#ifdef PIN_PA1
+  if(pin == PIN_PA1) return (PA << 3) | 1;
+#endif
+#ifdef PIN_PA2
+  if(pin == PIN_PA2) return (PA << 3) | 2;
+#endif
+#ifdef PIN_PA3
+  if(pin == PIN_PA3) return (PA << 3) | 3;
+#endif
+#ifdef PIN_PA4
+  if(pin == PIN_PA4) return (PA << 3) | 4;
+#endif
+#ifdef PIN_PA5
+  if(pin == PIN_PA5) return (PA << 3) | 5;
+#endif
+#ifdef PIN_PA6
+  if(pin == PIN_PA6) return (PA << 3) | 6;
+#endif
+#ifdef PIN_PA7
+  if(pin == PIN_PA7) return (PA << 3) | 7;
+#endif
+#ifdef PIN_PB0
+  if(pin == PIN_PB0) return (PB << 3) | 0;
+#endif
+#ifdef PIN_PB1
+  if(pin == PIN_PB1) return (PB << 3) | 1;
+#endif
+#ifdef PIN_PB2
+  if(pin == PIN_PB2) return (PB << 3) | 2;
+#endif
+#ifdef PIN_PB3
+  if(pin == PIN_PB3) return (PB << 3) | 3;
+#endif
+#ifdef PIN_PB4
+  if(pin == PIN_PB4) return (PB << 3) | 4;
+#endif
+#ifdef PIN_PB5
+  if(pin == PIN_PB5) return (PB << 3) | 5;
+#endif
+#ifdef PIN_PB6
+  if(pin == PIN_PB6) return (PB << 3) | 6;
+#endif
+#ifdef PIN_PB7
+  if(pin == PIN_PB7) return (PB << 3) | 7;
+#endif
+#ifdef PIN_PC0
+  if(pin == PIN_PC0) return (PC << 3) | 0;
+#endif
+#ifdef PIN_PC1
+  if(pin == PIN_PC1) return (PC << 3) | 1;
+#endif
+#ifdef PIN_PC2
+  if(pin == PIN_PC2) return (PC << 3) | 2;
+#endif
+#ifdef PIN_PC3
+  if(pin == PIN_PC3) return (PC << 3) | 3;
+#endif
+#ifdef PIN_PC4
+  if(pin == PIN_PC4) return (PC << 3) | 4;
+#endif
+#ifdef PIN_PC5
+  if(pin == PIN_PC5) return (PC << 3) | 5;
+#endif
+#ifdef PIN_PC6
+  if(pin == PIN_PC6) return (PC << 3) | 6;
+#endif
+#ifdef PIN_PC7
+  if(pin == PIN_PC7) return (PC << 3) | 7;
+#endif
+#ifdef PIN_PD0
+  if(pin == PIN_PD0) return (PD << 3) | 0;
+#endif
+#ifdef PIN_PD1
+  if(pin == PIN_PD1) return (PD << 3) | 1;
+#endif
+#ifdef PIN_PD2
+  if(pin == PIN_PD2) return (PD << 3) | 2;
+#endif
+#ifdef PIN_PD3
+  if(pin == PIN_PD3) return (PD << 3) | 3;
+#endif
+#ifdef PIN_PD4
+  if(pin == PIN_PD4) return (PD << 3) | 4;
+#endif
+#ifdef PIN_PD5
+  if(pin == PIN_PD5) return (PD << 3) | 5;
+#endif
+#ifdef PIN_PD6
+  if(pin == PIN_PD6) return (PD << 3) | 6;
+#endif
+#ifdef PIN_PD7
+  if(pin == PIN_PD7) return (PD << 3) | 7;
+#endif
+#ifdef PIN_PE0
+  if(pin == PIN_PE0) return (PE << 3) | 0;
+#endif
+#ifdef PIN_PE1
+  if(pin == PIN_PE1) return (PE << 3) | 1;
+#endif
+#ifdef PIN_PE2
+  if(pin == PIN_PE2) return (PE << 3) | 2;
+#endif
+#ifdef PIN_PE3
+  if(pin == PIN_PE3) return (PE << 3) | 3;
+#endif
+#ifdef PIN_PE4
+  if(pin == PIN_PE4) return (PE << 3) | 4;
+#endif
+#ifdef PIN_PE5
+  if(pin == PIN_PE5) return (PE << 3) | 5;
+#endif
+#ifdef PIN_PE6
+  if(pin == PIN_PE6) return (PE << 3) | 6;
+#endif
+#ifdef PIN_PE7
+  if(pin == PIN_PE7) return (PE << 3) | 7;
+#endif
+#ifdef PIN_PF0
+  if(pin == PIN_PF0) return (PF << 3) | 0;
+#endif
+#ifdef PIN_PF1
+  if(pin == PIN_PF1) return (PF << 3) | 1;
+#endif
+#ifdef PIN_PF2
+  if(pin == PIN_PF2) return (PF << 3) | 2;
+#endif
+#ifdef PIN_PF3
+  if(pin == PIN_PF3) return (PF << 3) | 3;
+#endif
+#ifdef PIN_PF4
+  if(pin == PIN_PF4) return (PF << 3) | 4;
+#endif
+#ifdef PIN_PF5
+  if(pin == PIN_PF5) return (PF << 3) | 5;
+#endif
+#ifdef PIN_PF6
+  if(pin == PIN_PF6) return (PF << 3) | 6;
+#endif
+#ifdef PIN_PF7
+  if(pin == PIN_PF7) return (PF << 3) | 7;
+#endif
+  return NOT_A_PIN;
+}
+
+PIN_CONSTEXPR uint8_t digitalPinToPortConst(uint8_t pin)
+{
+  return (digitalPinToPortBitConst(pin) == NOT_A_PIN) ? NOT_A_PORT : (digitalPinToPortBitConst(pin) >> 3);
+}
+
+PIN_CONSTEXPR uint8_t digitalPinToBitPositionConst(uint8_t pin)
+{
+  return (digitalPinToPortBitConst(pin) == NOT_A_PIN) ? NOT_A_PIN : (digitalPinToPortBitConst(pin) & 0x07);
+}
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/*
+ * digitalWrite() and digitalRead() turns into a single VPORT instruction when
+ * the pin is a compile time constant and has no PWM timer attached to it.
+ * Everything else is handled by _digitalWrite() and _digitalRead(),
+ * so the runtime behavior is identical.
+ * The definitions below are only used for inlining (gnu_inline). The
+ * functions keep their external linkage and out-of-line definitions in
+ * wiring_digital.c, so they can still be declared or taken the address of.
+ */
+void _digitalWrite(pin_size_t pin, uint8_t val);
+uint8_t _digitalRead(pin_size_t pin);
+
+extern inline __attribute__((gnu_inline, always_inline)) void digitalWrite(pin_size_t pin, uint8_t val)
+{
+  if(__builtin_constant_p(pin) && digitalPinToPortBitConst(pin) != NOT_A_PIN && !digitalPinHasPWM(pin))
+  {
+    VPORT_t *vport = &VPORTA + digitalPinToPortConst(pin);
+    uint8_t mask = 1 << digitalPinToBitPositionConst(pin);
+
+    // Input pins are left to _digitalWrite() since they need the pullup to be set
+    if(vport->DIR & mask)
+    {
+      if(val == LOW)
+        vport->OUT &= ~mask;
+      else if(val == CHANGE)
+        vport->IN = mask;
+      else
+        vport->OUT |= mask;
+      return;
+    }
+  }
+  _digitalWrite(pin, val);
+}
+
+extern inline __attribute__((gnu_inline, always_inline)) uint8_t digitalRead(pin_size_t pin)
+{
+  if(__builtin_constant_p(pin) && digitalPinToPortBitConst(pin) != NOT_A_PIN && !digitalPinHasPWM(pin))
+    return !!((&VPORTA + digitalPinToPortConst(pin))->IN & (1 << digitalPinToBitPositionConst(pin)));
+  return _digitalRead(pin);
+}
+
+extern inline __attribute__((gnu_inline, always_inline)) void digitalWriteFast(pin_size_t pin, uint8_t val)
+{
+  // Make sure pin is constant and know at compile time
+  check_constant_pin(pin);
+  if(digitalPinToPortBitConst(pin) == NOT_A_PIN)
+    badArg("Digital pin does not exist");
+
+  // Write pin value from VPORTx.OUT register
+  VPORT_t *vport = &VPORTA + digitalPinToPortConst(pin);
+  uint8_t mask = 1 << digitalPinToBitPositionConst(pin);
+
+  if(val == HIGH)
+    vport->OUT |= mask;
+  else if(val == LOW)
+    vport->OUT &= ~mask;
+  else // CHANGE
+    vport->IN = mask;
+}
+
+extern inline __attribute__((gnu_inline, always_inline)) uint8_t digitalReadFast(pin_size_t pin)
+{
+  // Make sure pin is constant and know at compile time
+  check_constant_pin(pin);
+  if(digitalPinToPortBitConst(pin) == NOT_A_PIN)
+    badArg("Digital pin does not exist");
+
+  // Read pin value from VPORTx.IN register
+  return !!((&VPORTA + digitalPinToPortConst(pin))->IN & (1 << digitalPinToBitPositionConst(pin)));
+}
+
+/*
+ * Each port has its own callback table and ISR, defined in WInterrupts_Px.c.
+ * attachInterrupt() only references the table of the port the pin belongs to
+ * when the pin is known at compile time, so ISRs for unused ports are never
+ * linked in. With a runtime pin number all port ISRs are pulled in.
+ * The definitions below are only used for inlining (gnu_inline). Calls that
+ * aren't inlined, like through a function pointer, go to the out-of-line
+ * versions in WInterrupts_pin.c, which pull in all port ISRs.
+ */
+typedef void (*voidFuncPtrParam)(void*);
+
+typedef union
+{
+  voidFuncPtr func;              // attachInterrupt()
+  voidFuncPtrParam func_param;   // attachInterruptParam()
+} port_int_callback_t;
+
+typedef struct
+{
+  port_int_callback_t callback[8];
+  void *param[8];
+  uint8_t has_param;             // Bit n set if pin n uses func_param
+} port_int_table_t;
+
+extern port_int_table_t _portIntTableA, _portIntTableB, _portIntTableC,
+                        _portIntTableD, _portIntTableE, _portIntTableF;
+
+void _attachInterrupt(uint8_t pin, port_int_table_t *table, port_int_callback_t callback, uint8_t has_param, uint8_t mode, void *param);
+void _detachInterrupt(uint8_t pin, port_int_table_t *table);
+
+static inline __attribute__((always_inline)) port_int_table_t *digitalPinToIntTable(pin_size_t pin)
+{
+  uint8_t port = __builtin_constant_p(pin) ? digitalPinToPortConst(pin) : digitalPinToPort(pin);
+  switch(port)
+  {
+    case PA: return &_portIntTableA;
+    case PB: return &_portIntTableB;
+    case PC: return &_portIntTableC;
+    case PD: return &_portIntTableD;
+    case PE: return &_portIntTableE;
+    case PF: return &_portIntTableF;
+    default: return NULL;
+  }
+}
+
+extern inline __attribute__((gnu_inline, always_inline)) void attachInterruptParam(pin_size_t pin, voidFuncPtrParam callback, uint8_t mode, void *param)
+{
+  port_int_callback_t cb;
+  cb.func_param = callback;
+  _attachInterrupt(pin, digitalPinToIntTable(pin), cb, 1, mode, param);
+}
+
+extern inline __attribute__((gnu_inline, always_inline)) void attachInterrupt(pin_size_t pin, voidFuncPtr callback, uint8_t mode)
+{
+  port_int_callback_t cb;
+  cb.func = callback;
+  _attachInterrupt(pin, digitalPinToIntTable(pin), cb, 0, mode, NULL);
+}
+
+extern inline __attribute__((gnu_inline, always_inline)) void detachInterrupt(pin_size_t pin)
+{
+  _detachInterrupt(pin, digitalPinToIntTable(pin));
+}
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
 #endif
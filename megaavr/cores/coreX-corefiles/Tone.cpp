@@ -39,52 +39,91 @@
 
 #include "Arduino.h"
 #include "pins_arduino.h"
-
-/* For more than one tone, change AVAILABLE_TONE_PINS and uncomment the correct
-    number of timers 
+#include "Tone_private.h"
+
+/* Every TCB timer except the one used for millis can generate a tone, so up
+   to three tones can play at the same time (two on parts without TCB3).
+   Each tone interrupt lives in its own file (Tone0.cpp to Tone3.cpp), which
+   the linker only pulls in for timers nobody else has claimed. A library or
+   sketch that defines its own TCB interrupt, such as Servo, claims the timer
+   with TCB_CLAIM(), and tone() never touches a claimed timer.
+   A timer that generates a tone can't be used for PWM at the same time, and
+   is handed back to analogWrite() when the tone ends.
 */
-#define AVAILABLE_TONE_PINS 1
 
-#define USE_TIMERB1 // interferes with TCB1 PWM
-/*
-#define USE_TIMERB2        // interferes with TCB2 PWM, and timer in many configurations
-#define USE_TIMERB0        // interferes with TCB0 PWM
-*/
-#if !defined(USE_TIMERB0) && !defined(USE_TIMERB1) && !defined(USE_TIMERB2) && !defined(USE_TIMERB3)
-#error "No timers allowed for tone()"
-/* Please uncomment a timer above and rebuild */
+#if defined(TCB3)
+#define TONE_TIMERS 4
+#else
+#define TONE_TIMERS 3
 #endif
 
-// Can't use timer assigned for application time tracking (usually TIMERB2 or TIMERB3)
-// Using TIMERA0 NOT RECOMMENDED -- all other timers use its clock!
-static volatile TCB_t *_timer =
-#if defined(USE_TIMERB0)
-    &TCB0;
+// Order the timers are handed out in. TCB1 comes first, since it has always
+// been the tone timer
+static const uint8_t tone_timer_order[TONE_TIMERS] = {
+  1, 0, 2,
+#if defined(TCB3)
+  3,
 #endif
-#if defined(USE_TIMERB1)
-&TCB1;
+};
+
+// Waveform output pins of TCB0..TCB3 as port and bit position, for the
+// default and alternative route
+static const uint8_t tcb_output_pins[4][2][2] = {
+  { { PA, 2 }, { PF, 4 } },
+  { { PA, 3 }, { PF, 5 } },
+  { { PC, 0 }, { PB, 4 } },
+  { { PB, 5 }, { PC, 1 } },
+};
+
+typedef struct
+{
+  // Pin currently playing a tone on this timer, or NOT_A_PIN if free
+  volatile uint8_t pin;
+  // True when the tone is generated by the timer waveform output rather than
+  // by toggling the pin from the interrupt
+  bool waveform_output;
+  // toggle_count:
+  //  > 0 - duration specified
+  //  = 0 - stopped
+  //  < 0 - infinitely (until noTone() called, or new tone() called)
+  volatile long toggle_count;
+  volatile uint8_t *outtgl_reg;
+  uint8_t bit_mask;
+  // PORTMUX route of the timer output before the waveform output moved it,
+  // or -1 if it hasn't been moved
+  int8_t saved_route;
+} tone_channel_t;
+
+static tone_channel_t tone_channels[TONE_TIMERS] = {
+  { NOT_A_PIN, false, 0, 0, 0, -1 },
+  { NOT_A_PIN, false, 0, 0, 0, -1 },
+  { NOT_A_PIN, false, 0, 0, 0, -1 },
+#if defined(TCB3)
+  { NOT_A_PIN, false, 0, 0, 0, -1 },
 #endif
-#if defined(USE_TIMERB2)
-&TCB2;
+};
+
+// Set to 1 by TCB_CLAIM() in a library or sketch that uses the timer, or
+// to 0 by ToneN.cpp together with the tone interrupt
+#if !defined(MILLIS_USE_TIMERB0)
+extern "C" const uint8_t tcb0_claimed;
 #endif
-#if defined(USE_TIMERB3)
-&TCB3;
+#if !defined(MILLIS_USE_TIMERB1)
+extern "C" const uint8_t tcb1_claimed;
+#endif
+#if !defined(MILLIS_USE_TIMERB2)
+extern "C" const uint8_t tcb2_claimed;
+#endif
+#if defined(TCB3) && !defined(MILLIS_USE_TIMERB3)
+extern "C" const uint8_t tcb3_claimed;
 #endif
-
-static int _pin = NOT_A_PIN;
-
-// timerx_toggle_count:
-//  > 0 - duration specified
-//  = 0 - stopped
-//  < 0 - infinitely (until stop() method called, or new play() called)
-
-volatile long timer_toggle_count;
-volatile uint8_t *timer_outtgl_reg;
-volatile uint8_t timer_bit_mask;
 
 // helper functions
-static void disableTimer();
+static void disableTimer(uint8_t timer_index);
 static byte timerPrescaler();
+static bool timerAvailable(uint8_t timer_index);
+static int8_t findTimer(uint8_t pin);
+static bool waveformOutput(uint8_t timer_index, uint8_t pin, unsigned int frequency, unsigned long duration);
 
 // frequency (in hertz) and duration (in milliseconds).
 void tone(uint8_t pin, unsigned int frequency, unsigned long duration)
@@ -92,22 +131,32 @@ void tone(uint8_t pin, unsigned int frequency, unsigned long duration)
   long toggle_count = 0;
   uint32_t compare_val = 0;
 
-  if (_pin != pin)
+  int8_t timer_index = findTimer(pin);
+  if (timer_index < 0)
+    return; // All timers are busy
+  tone_channel_t *channel = &tone_channels[timer_index];
+  TCB_t *timer = &TCB0 + timer_index;
+
+  if (channel->pin != pin)
   {
     pinMode(pin, OUTPUT);
-    _pin = pin;
+    channel->pin = pin;
   }
 
   // Get pin related stuff
-  PORT_t *port = digitalPinToPortStruct(_pin);
+  PORT_t *port = digitalPinToPortStruct(pin);
   uint8_t *port_outtgl = (uint8_t *)&(port->OUTTGL);
-  uint8_t bit_mask = digitalPinToBitMask(_pin);
+  uint8_t bit_mask = digitalPinToBitMask(pin);
 
   if (frequency == 0)
   {
     bit_mask = 0;
     frequency = 1;
   }
+  else if (waveformOutput(timer_index, pin, frequency, duration))
+  {
+    return;
+  }
 
   // Calculate compare value, assuming F_CPU/2 used as clock
   compare_val = F_CPU / frequency / 4 - 1;
@@ -142,29 +191,30 @@ void tone(uint8_t pin, unsigned int frequency, unsigned long duration)
   // TCA default initialization is in wiring.c -- init()  )
   if (prescaler != 0)
   {
-    _timer->CTRLA = TCB_CLKSEL_CLKTCA_gc;
+    timer->CTRLA = TCB_CLKSEL_CLKTCA_gc;
   }
   else
   {
-    _timer->CTRLA = TCB_CLKSEL_CLKDIV2_gc;
+    timer->CTRLA = TCB_CLKSEL_CLKDIV2_gc;
   }
 
   // Timer to Periodic interrupt mode
   // This write will also disable any active PWM outputs
-  _timer->CTRLB = TCB_CNTMODE_INT_gc;
+  timer->CTRLB = TCB_CNTMODE_INT_gc;
+  channel->waveform_output = false;
 
   // Write compare register
-  _timer->CCMP = compare_val;
+  timer->CCMP = compare_val;
 
   // Enable interrupt
-  _timer->INTCTRL = TCB_CAPTEI_bm;
+  timer->INTCTRL = TCB_CAPTEI_bm;
 
-  timer_outtgl_reg = port_outtgl;
-  timer_bit_mask = bit_mask;
-  timer_toggle_count = toggle_count;
+  channel->outtgl_reg = port_outtgl;
+  channel->bit_mask = bit_mask;
+  channel->toggle_count = toggle_count;
 
   // Enable timer
-  _timer->CTRLA |= TCB_ENABLE_bm;
+  timer->CTRLA |= TCB_ENABLE_bm;
 
   SREG = status;
 }
@@ -172,14 +222,141 @@ void tone(uint8_t pin, unsigned int frequency, unsigned long duration)
 // pin which currently is being used for a tone
 void noTone(uint8_t pin)
 {
-  if (pin == _pin)
+  for (uint8_t i = 0; i < TONE_TIMERS; i++)
   {
-    timer_toggle_count = 0;
-    //disableTimer();
+    tone_channel_t *channel = &tone_channels[i];
+    if (channel->pin != pin)
+      continue;
+
+    uint8_t status = SREG;
+    cli();
+    channel->toggle_count = 0;
+    disableTimer(i);
+    channel->pin = NOT_A_PIN;
+    SREG = status;
+
     // Keep pin low after disabling of timer
-    digitalWrite(_pin, LOW);
-    _pin = NOT_A_PIN;
+    digitalWrite(pin, LOW);
+  }
+}
+
+// helper function for tone()
+// Returns which route has the timer waveform output on the pin, or -1
+static int8_t outputRoute(uint8_t timer_index, uint8_t pin)
+{
+  uint8_t port = digitalPinToPort(pin);
+  uint8_t bit_pos = digitalPinToBitPosition(pin);
+  for (uint8_t route = 0; route < 2; route++)
+  {
+    if (tcb_output_pins[timer_index][route][0] == port
+    && tcb_output_pins[timer_index][route][1] == bit_pos)
+      return route;
+  }
+  return -1;
+}
+
+// helper function for tone()
+// Returns the timer already playing on the pin, a free timer with its
+// waveform output on the pin, or any free timer. -1 if all timers are busy
+static int8_t findTimer(uint8_t pin)
+{
+  for (uint8_t i = 0; i < TONE_TIMERS; i++)
+  {
+    if (tone_channels[i].pin == pin)
+      return i;
+  }
+
+  int8_t free_timer = -1;
+  for (uint8_t i = 0; i < TONE_TIMERS; i++)
+  {
+    uint8_t timer_index = tone_timer_order[i];
+    if (tone_channels[timer_index].pin != NOT_A_PIN || !timerAvailable(timer_index))
+      continue;
+    if (outputRoute(timer_index, pin) >= 0)
+      return timer_index;
+    if (free_timer < 0)
+      free_timer = timer_index;
+  }
+  return free_timer;
+}
+
+// helper function for tone()
+// Let the timer generate the tone on its waveform output in 8-bit PWM mode,
+// if the pin is one of the two timer output pins and the frequency can be
+// generated accurately. The interrupt is then only used to count periods
+// when a duration is given, instead of toggling the pin twice per period
+static bool waveformOutput(uint8_t timer_index, uint8_t pin, unsigned int frequency, unsigned long duration)
+{
+  TCB_t *timer = &TCB0 + timer_index;
+  tone_channel_t *channel = &tone_channels[timer_index];
+
+  int8_t route = outputRoute(timer_index, pin);
+  if (route < 0)
+    return false;
+
+  // Use the fastest clock where the period fits in 8 bits. A period of at
+  // least 50 clock cycles keeps the frequency within 1% of the requested one
+  uint8_t clksel = TCB_CLKSEL_CLKDIV1_gc;
+  uint32_t clk = F_CPU;
+  if (clk / frequency > 256)
+  {
+    clksel = TCB_CLKSEL_CLKDIV2_gc;
+    clk = F_CPU / 2;
+  }
+  if (clk / frequency > 256)
+  {
+    clksel = TCB_CLKSEL_CLKTCA_gc;
+    clk = F_CPU / timerPrescaler();
+  }
+  uint32_t period = (clk + frequency / 2) / frequency;
+  if (period < 50 || period > 256)
+    return false;
+
+  // Count timer periods rather than pin toggles
+  long period_count = -1;
+  if (duration > 0)
+  {
+    period_count = (uint32_t)frequency * duration / 1000;
+    if (period_count == 0)
+      period_count = 1;
+  }
+
+  // Output low when the tone stops
+  digitalWrite(pin, LOW);
+
+  uint8_t status = SREG;
+  cli();
+
+  timer->CTRLA = 0;
+  timer->INTCTRL = 0;
+
+  uint8_t route_mask = (1 << timer_index);
+  if (channel->saved_route < 0)
+    channel->saved_route = (PORTMUX.TCBROUTEA & route_mask) ? 1 : 0;
+  if (route)
+    PORTMUX.TCBROUTEA |= route_mask;
+  else
+    PORTMUX.TCBROUTEA &= ~route_mask;
+
+  timer->CTRLB = TCB_CNTMODE_PWM8_gc | TCB_CCMPEN_bm;
+  timer->CNT = 0;
+  timer->CCMPL = period - 1;
+  timer->CCMPH = period / 2;
+
+  // The capture interrupt is set once per period in 8-bit PWM mode.
+  // An endless tone needs no interrupt at all
+  channel->toggle_count = period_count;
+  if (period_count > 0)
+  {
+    timer->INTFLAGS = TCB_CAPT_bm;
+    timer->INTCTRL = TCB_CAPT_bm;
   }
+  channel->waveform_output = true;
+
+  timer->CTRLA = clksel | TCB_ENABLE_bm;
+
+  SREG = status;
+  return true;
 }
 
 // helper function for noTone()
@@ -205,57 +382,96 @@ static byte timerPrescaler()
 }
 
 // helper function for noTone()
-/* Works for all timers -- the timer being disabled will go back to the 
+/* Works for all timers -- the timer being disabled will go back to the
     configuration it had to output PWM for analogWrite() */
-static void disableTimer()
+static void disableTimer(uint8_t timer_index)
 {
-  // Reinit back to producing PWM -- timer will be type B
+  TCB_t *timer = &TCB0 + timer_index;
+  tone_channel_t *channel = &tone_channels[timer_index];
+
   // Disable interrupt
-  _timer->INTCTRL = 0;
+  timer->INTCTRL = 0;
   // Disable timer
-  _timer->CTRLA = 0;
-
-#if 0
-    // RESTORE PWM FUNCTIONALITY:
-    /* 8 bit PWM mode, but do not enable output yet, will do in analogWrite() */
-    _timer->CTRLB = (TCB_CNTMODE_PWM8_gc);
-    /* Assign 8-bit period */
-    _timer->CCMPL = PWM_TIMER_PERIOD;
-    /* default duty 50%, set when output enabled */
-    _timer->CCMPH = PWM_TIMER_COMPARE;
-    /* Use TCA clock (250kHz) and enable */
-    /* (sync update commented out, might try to synchronize later */
-    _timer->CTRLA = (TCB_CLKSEL_CLKTCA_gc) | (TCB_ENABLE_bm);
-#endif
+  timer->CTRLA = 0;
+
+  // RESTORE PWM FUNCTIONALITY, the same way init() sets it up:
+  /* 8 bit PWM mode, but do not enable output yet, will do in analogWrite() */
+  timer->CTRLB = (TCB_CNTMODE_PWM8_gc);
+  /* Assign 8-bit period */
+  timer->CCMPL = PWM_TIMER_PERIOD;
+  /* default duty 50%, set when output enabled */
+  timer->CCMPH = PWM_TIMER_COMPARE;
+  timer->INTFLAGS = TCB_CAPT_bm;
+
+  /* Put the output back on the pin analogWrite() routed it to */
+  if (channel->saved_route >= 0)
+  {
+    uint8_t route_mask = (1 << timer_index);
+    if (channel->saved_route)
+      PORTMUX.TCBROUTEA |= route_mask;
+    else
+      PORTMUX.TCBROUTEA &= ~route_mask;
+    channel->saved_route = -1;
+  }
+
+  /* Use TCA clock (250kHz) and enable */
+  timer->CTRLA = (TCB_CLKSEL_CLKTCA_gc) | (TCB_ENABLE_bm);
 }
 
-#if defined USE_TIMERB0
-ISR(TCB0_INT_vect)
-#elif defined USE_TIMERB1
-ISR(TCB1_INT_vect)
-#elif defined USE_TIMERB2
-ISR(TCB2_INT_vect)
-#endif
+void toneHandler(uint8_t timer_index)
 {
-  if (timer_toggle_count != 0)
+  tone_channel_t *channel = &tone_channels[timer_index];
+  TCB_t *timer = &TCB0 + timer_index;
+
+  if (channel->toggle_count != 0)
   {
-    // toggle the pin
-    *timer_outtgl_reg = timer_bit_mask;
+    // toggle the pin, unless the timer drives it and periods are counted.
+    // outtgl_reg is never set in waveform mode
+    if (!channel->waveform_output)
+      *channel->outtgl_reg = channel->bit_mask;
 
     // If duration was defined, decrement
-    if (timer_toggle_count > 0)
+    if (channel->toggle_count > 0)
     {
-      timer_toggle_count--;
+      channel->toggle_count--;
     }
 
     // If no duration (toggle count negative), go on until noTone() call
   }
-  else if (timer_toggle_count == 0)
-  { // If toggle count = 0, stop
-
-    disableTimer();
+  else
+  { // If toggle count = 0, stop, and hand the timer back to the pool
+    disableTimer(timer_index);
+    channel->pin = NOT_A_PIN;
   }
 
   /* Clear flag */
-  _timer->INTFLAGS = TCB_CAPT_bm;
+  timer->INTFLAGS = TCB_CAPT_bm;
+}
+
+// helper function for tone()
+// A timer can be used if it isn't the millis timer, and no one else has
+// claimed it
+static bool timerAvailable(uint8_t timer_index)
+{
+  switch (timer_index)
+  {
+#if !defined(MILLIS_USE_TIMERB0)
+    case 0:
+      return !tcb0_claimed;
+#endif
+#if !defined(MILLIS_USE_TIMERB1)
+    case 1:
+      return !tcb1_claimed;
+#endif
+#if !defined(MILLIS_USE_TIMERB2)
+    case 2:
+      return !tcb2_claimed;
+#endif
+#if defined(TCB3) && !defined(MILLIS_USE_TIMERB3)
+    case 3:
+      return !tcb3_claimed;
+#endif
+    default:
+      return false;
+  }
 }
@@ -0,0 +1,29 @@
+/*
+  Tone0.cpp - TCB0 interrupt for tone()
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+*/
+
+#include "Arduino.h"
+#include "Tone_private.h"
+
+// tone() reads tcb0_claimed, and this file is only pulled in from the core
+// archive if nothing else defines it. A library or sketch that claims the
+// timer with TCB_CLAIM(0) keeps its own TCB0_INT_vect, and this one is left out
+
+#if !defined(MILLIS_USE_TIMERB0)
+extern "C" const uint8_t tcb0_claimed = 0;
+
+ISR(TCB0_INT_vect)
+{
+  toneHandler(0);
+}
+#endif
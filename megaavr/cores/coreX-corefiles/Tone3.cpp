@@ -0,0 +1,29 @@
+/*
+  Tone3.cpp - TCB3 interrupt for tone()
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+*/
+
+#include "Arduino.h"
+#include "Tone_private.h"
+
+// tone() reads tcb3_claimed, and this file is only pulled in from the core
+// archive if nothing else defines it. A library or sketch that claims the
+// timer with TCB_CLAIM(3) keeps its own TCB3_INT_vect, and this one is left out
+
+#if defined(TCB3) && !defined(MILLIS_USE_TIMERB3)
+extern "C" const uint8_t tcb3_claimed = 0;
+
+ISR(TCB3_INT_vect)
+{
+  toneHandler(3);
+}
+#endif
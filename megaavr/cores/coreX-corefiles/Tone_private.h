@@ -0,0 +1,8 @@
+/* Tone_private.h - shared by Tone.cpp and the per-timer tone interrupts */
+
+#pragma once
+
+#include <stdint.h>
+
+// Called from the TCBn interrupt defined in ToneN.cpp
+void toneHandler(uint8_t timer_index);
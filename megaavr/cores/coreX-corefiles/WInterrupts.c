@@ -29,126 +29,85 @@
 #include <stdio.h>
 
 #include "wiring_private.h"
+#include "WInterrupts_private.h"
 
-static volatile voidFuncPtr intFunc[EXTERNAL_NUM_INTERRUPTS];
+/* Index of the lowest set bit in a nibble, used by port_interrupt_handler() */
+const uint8_t _port_int_ffs[16] = {0, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0};
 
-void attachInterrupt(uint8_t pin, void (*userFunc)(void), uint8_t mode)
+void _attachInterrupt(uint8_t pin, port_int_table_t *table, port_int_callback_t callback, uint8_t has_param, uint8_t mode, void *param)
 {
   /* Get bit position and check pin validity */
   uint8_t bit_pos = digitalPinToBitPosition(pin);
-  if (bit_pos == NOT_A_PIN) return;
+  if (bit_pos == NOT_A_PIN || table == NULL) return;
 
-  /* Get interrupt number from pin */
-  uint8_t interruptNum = (digitalPinToPort(pin) * 8) + bit_pos;
+  // Configure the interrupt mode (trigger on low input, any change, rising
+  // edge, or falling edge).  The mode constants were chosen to correspond
+  // to the configuration bits in the hardware register, so we simply apply
+  // the setting in the pin control register
 
-  /* Check interrupt number and apply function pointer to correct array index */
-  if (interruptNum < EXTERNAL_NUM_INTERRUPTS)
+  switch (mode)
   {
-    intFunc[interruptNum] = userFunc;
-
-    // Configure the interrupt mode (trigger on low input, any change, rising
-    // edge, or falling edge).  The mode constants were chosen to correspond
-    // to the configuration bits in the hardware register, so we simply apply
-    // the setting in the pin control register
-
-    switch (mode)
-    {
-      case CHANGE:
-        mode = PORT_ISC_BOTHEDGES_gc;
-        break;
-      case FALLING:
-        mode = PORT_ISC_FALLING_gc;
-        break;
-      case RISING:
-        mode = PORT_ISC_RISING_gc;
-        break;
-      case LOW:
-        mode = PORT_ISC_LEVEL_gc;
-        break;
-      default:
-        // AVR doesn't support level triggered interrupts
-        return;
-    }
-
-    // Enable the interrupt.
-
-    /* Get pointer to correct pin control register */
-    PORT_t *port = digitalPinToPortStruct(pin);
-    volatile uint8_t *pin_ctrl_reg = getPINnCTRLregister(port, bit_pos);
-
-    /* Clear any previous setting */
-    *pin_ctrl_reg &= ~(PORT_ISC_gm);
-
-    /* Apply ISC setting */
-    *pin_ctrl_reg |= mode;
+    case CHANGE:
+      mode = PORT_ISC_BOTHEDGES_gc;
+      break;
+    case FALLING:
+      mode = PORT_ISC_FALLING_gc;
+      break;
+    case RISING:
+      mode = PORT_ISC_RISING_gc;
+      break;
+    case LOW:
+      mode = PORT_ISC_LEVEL_gc;
+      break;
+    default:
+      // AVR doesn't support level triggered interrupts
+      return;
   }
-}
 
-void detachInterrupt(uint8_t pin)
-{
-  /* Get bit position and check pin validity */
-  uint8_t bit_pos = digitalPinToBitPosition(pin);
-  if (bit_pos == NOT_A_PIN) return;
+  /* Get pointer to correct pin control register */
+  PORT_t *port = digitalPinToPortStruct(pin);
+  volatile uint8_t *pin_ctrl_reg = getPINnCTRLregister(port, bit_pos);
 
-  /* Get interrupt number from pin */
-  uint8_t interruptNum = (digitalPinToPort(pin) * 8) + bit_pos;
+  /* The ISR must never see a half written function/param pair */
+  uint8_t status = SREG;
+  cli();
 
-  if (interruptNum < EXTERNAL_NUM_INTERRUPTS)
-  {
-    // Disable the interrupt.
+  table->callback[bit_pos] = callback;
+  table->param[bit_pos] = param;
+  if (has_param)
+    table->has_param |= (1 << bit_pos);
+  else
+    table->has_param &= ~(1 << bit_pos);
 
-    /* Get pointer to correct pin control register */
-    PORT_t *port = digitalPinToPortStruct(pin);
-    volatile uint8_t *pin_ctrl_reg = getPINnCTRLregister(port, bit_pos);
+  /* Clear any previous setting */
+  *pin_ctrl_reg &= ~(PORT_ISC_gm);
 
-    /* Clear ISC setting */
-    *pin_ctrl_reg &= ~(PORT_ISC_gm);
+  /* Apply ISC setting */
+  *pin_ctrl_reg |= mode;
 
-    intFunc[interruptNum] = 0;
-  }
+  SREG = status;
 }
 
-static void port_interrupt_handler(uint8_t port)
+void _detachInterrupt(uint8_t pin, port_int_table_t *table)
 {
-  PORT_t *portStruct = portToPortStruct(port);
-  /* Copy flags */
-  uint8_t int_flags = portStruct->INTFLAGS;
+  /* Get bit position and check pin validity */
+  uint8_t bit_pos = digitalPinToBitPosition(pin);
+  if (bit_pos == NOT_A_PIN || table == NULL) return;
 
-  uint8_t bit_pos = PIN0_bp, bit_mask = PIN0_bm;
+  // Disable the interrupt.
 
-  /* Iterate through flags */
-  while (bit_pos <= PIN7_bp)
-  {
-    /* Check if flag raised */
-    if (int_flags & bit_mask)
-    {
-      /* Get interrupt */
-      uint8_t interrupt_num = port * 8 + bit_pos;
-
-      /* Check if function defined */
-      if (intFunc[interrupt_num] != 0)
-      {
-        /* Call function */
-        intFunc[interrupt_num]();
-      }
-    }
-    bit_pos++;
-    bit_mask = (bit_mask << 1);
-  }
+  /* Get pointer to correct pin control register */
+  PORT_t *port = digitalPinToPortStruct(pin);
+  volatile uint8_t *pin_ctrl_reg = getPINnCTRLregister(port, bit_pos);
 
-  /* Clear flags that have been handled */
-  portStruct->INTFLAGS = int_flags;
-}
+  uint8_t status = SREG;
+  cli();
 
-#define IMPLEMENT_ISR(vect, port) \
-  ISR(vect)                       \
-  {                               \
-    port_interrupt_handler(port); \
-  }
+  /* Clear ISC setting */
+  *pin_ctrl_reg &= ~(PORT_ISC_gm);
+
+  table->callback[bit_pos].func = 0;
+  table->param[bit_pos] = 0;
 
-IMPLEMENT_ISR(PORTA_PORT_vect, PA)
-IMPLEMENT_ISR(PORTB_PORT_vect, PB)
-IMPLEMENT_ISR(PORTC_PORT_vect, PC)
-IMPLEMENT_ISR(PORTD_PORT_vect, PD)
-IMPLEMENT_ISR(PORTE_PORT_vect, PE)
-IMPLEMENT_ISR(PORTF_PORT_vect, PF)
+  SREG = status;
+}
@@ -0,0 +1,3 @@
+#include "WInterrupts_private.h"
+
+IMPLEMENT_PORT_ISR(C)
@@ -0,0 +1,44 @@
+/*
+  WInterrupts_pin.c - Out-of-line attachInterrupt() and detachInterrupt()
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "wiring_private.h"
+
+// Used when a call isn't inlined from Arduino.h, for instance through a
+// function pointer. The pin isn't known at compile time here, so every port
+// table is referenced. Kept apart from WInterrupts.c, so inlined calls don't
+// pull in the ISRs for all ports
+
+void attachInterrupt(uint8_t pin, voidFuncPtr callback, uint8_t mode)
+{
+  port_int_callback_t cb;
+  cb.func = callback;
+  _attachInterrupt(pin, digitalPinToIntTable(pin), cb, 0, mode, NULL);
+}
+
+void attachInterruptParam(uint8_t pin, voidFuncPtrParam callback, uint8_t mode, void *param)
+{
+  port_int_callback_t cb;
+  cb.func_param = callback;
+  _attachInterrupt(pin, digitalPinToIntTable(pin), cb, 1, mode, param);
+}
+
+void detachInterrupt(uint8_t pin)
+{
+  _detachInterrupt(pin, digitalPinToIntTable(pin));
+}
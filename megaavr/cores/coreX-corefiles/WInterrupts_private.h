@@ -0,0 +1,74 @@
+/*
+  WInterrupts_private.h - Port interrupt dispatch shared by the per-port ISRs
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#ifndef WInterrupts_private_h
+#define WInterrupts_private_h
+
+#include "wiring_private.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+extern const uint8_t _port_int_ffs[16];
+
+static inline __attribute__((always_inline)) void port_interrupt_handler(PORT_t *port, port_int_table_t *table)
+{
+  /* Copy flags */
+  uint8_t int_flags = port->INTFLAGS;
+  uint8_t pending = int_flags;
+
+  /* Only visit the pins that actually have their flag raised */
+  while (pending)
+  {
+    uint8_t bit_pos = (pending & 0x0F) ? _port_int_ffs[pending & 0x0F] : 4 + _port_int_ffs[pending >> 4];
+
+    /* Check if function defined, and call it through its own type */
+    port_int_callback_t callback = table->callback[bit_pos];
+    if (callback.func)
+    {
+      if (table->has_param & (1 << bit_pos))
+        callback.func_param(table->param[bit_pos]);
+      else
+        callback.func();
+    }
+
+    /* Clear lowest set bit */
+    pending &= pending - 1;
+  }
+
+  /* Clear flags that have been handled */
+  port->INTFLAGS = int_flags;
+}
+
+// Each port ISR lives in its own file, so the linker only pulls in
+// the ISRs and tables for the ports attachInterrupt() is used on
+#define IMPLEMENT_PORT_ISR(P)                            \
+  port_int_table_t _portIntTable##P;                     \
+  ISR(PORT##P##_PORT_vect)                               \
+  {                                                      \
+    port_interrupt_handler(&PORT##P, &_portIntTable##P); \
+  }
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -0,0 +1,69 @@
+#include "Arduino.h"
+#include "pins_arduino.h"
+#include "wiring_private.h"
+
+PinGroup::PinGroup(const uint8_t *pins, uint8_t count) {
+  if(count > PIN_GROUP_MAX_PINS)
+    count = PIN_GROUP_MAX_PINS;
+  _count = count;
+
+  for(uint8_t p = 0; p < NUM_TOTAL_PORTS; p++)
+    _port_mask[p] = 0;
+
+  // Invalid pins get an empty bit mask and are ignored by write() and read()
+  for(uint8_t i = 0; i < count; i++) {
+    uint8_t bit_mask = digitalPinToBitMask(pins[i]);
+    if(bit_mask == NOT_A_PIN) {
+      _port[i] = PA;
+      _bit_mask[i] = 0;
+    } else {
+      _port[i] = digitalPinToPort(pins[i]);
+      _bit_mask[i] = bit_mask;
+      _port_mask[_port[i]] |= bit_mask;
+    }
+  }
+}
+
+void PinGroup::write(uint16_t value) {
+  // Spread the value out over the ports before touching any hardware
+  uint8_t out[NUM_TOTAL_PORTS] = {0};
+  for(uint8_t i = 0; i < _count; i++) {
+    if(value & 0x01)
+      out[_port[i]] |= _bit_mask[i];
+    value >>= 1;
+  }
+
+  // Keep all port writes in one critical section to minimize skew between ports
+  uint8_t savedSREG = SREG;
+  cli();
+  for(uint8_t p = 0; p < NUM_TOTAL_PORTS; p++) {
+    uint8_t mask = _port_mask[p];
+    if(mask) {
+      VPORT_t *vport = &VPORTA + p;
+      vport->OUT = (vport->OUT & ~mask) | out[p];
+    }
+  }
+  SREG = savedSREG;
+}
+
+uint16_t PinGroup::read() {
+  // Sample every port involved first, then assemble the value
+  uint8_t in[NUM_TOTAL_PORTS];
+  for(uint8_t p = 0; p < NUM_TOTAL_PORTS; p++)
+    in[p] = _port_mask[p] ? (&VPORTA + p)->IN : 0;
+
+  uint16_t value = 0;
+  for(uint8_t i = _count; i > 0; i--) {
+    value <<= 1;
+    if(in[_port[i - 1]] & _bit_mask[i - 1])
+      value |= 0x01;
+  }
+  return value;
+}
+
+void PinGroup::mode(uint8_t mode) {
+  for(uint8_t p = 0; p < NUM_TOTAL_PORTS; p++) {
+    if(_port_mask[p])
+      portMode(p, _port_mask[p], mode);
+  }
+}
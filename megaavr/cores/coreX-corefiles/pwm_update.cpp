@@ -0,0 +1,85 @@
+#include "Arduino.h"
+#include "wiring_private.h"
+
+// Kept apart from pwm_write.cpp so the TCA0 overflow/underflow vector is
+// only taken by sketches that use pwmUpdateBegin() and pwmUpdateEnd(), or
+// a library that attaches to the single mode overflow, like PCM
+
+static void (*volatile overflow_callback)(void);
+
+void pwmAttachOverflow(void (*callback)(void)) {
+  overflow_callback = callback;
+}
+
+void pwmUpdateBegin() {
+  if(!tca0_split_mode()) {
+    // Lock the buffer registers, CMPnBUF is no longer copied at UPDATE
+    TCA0.SINGLE.CTRLESET = TCA_SINGLE_LUPD_bm;
+    return;
+  }
+
+  // A commit that hasn't happened yet is merged into this update
+  uint8_t savedSREG = SREG;
+  cli();
+  _pwm_update_active = 1;
+  TCA0.SPLIT.INTCTRL &= ~TCA_SPLIT_LUNF_bm;
+  SREG = savedSREG;
+}
+
+void pwmUpdateEnd() {
+  if(!tca0_split_mode()) {
+    // All buffered compare values are copied at the next UPDATE event
+    TCA0.SINGLE.CTRLECLR = TCA_SINGLE_LUPD_bm;
+    return;
+  }
+
+  uint8_t savedSREG = SREG;
+  cli();
+  _pwm_update_active = 0;
+  if(_pwm_staged_mask) {
+    // The flag is set on every underflow, so clear it to wait for the next one
+    TCA0.SPLIT.INTFLAGS = TCA_SPLIT_LUNF_bm;
+    TCA0.SPLIT.INTCTRL |= TCA_SPLIT_LUNF_bm;
+  }
+  SREG = savedSREG;
+}
+
+// In single mode this is the overflow interrupt, handed to the attached
+// callback. Both split mode counters share the same period, so the low
+// counter underflow marks the start of a new PWM period for all six channels
+ISR(TCA0_LUNF_vect) {
+  if(!tca0_split_mode()) {
+    TCA0.SINGLE.INTFLAGS = TCA_SINGLE_OVF_bm;
+    void (*callback)(void) = overflow_callback;
+    if(callback)
+      callback();
+    return;
+  }
+
+  uint8_t mask = _pwm_staged_mask;
+  uint8_t off = _pwm_staged_off;
+  uint8_t enable = 0;
+  uint8_t disable = 0;
+  for(uint8_t channel = 0; channel < 6; channel++) {
+    if(mask & (1 << channel)) {
+      uint8_t bitpos = channel;
+      if(channel >= 3)
+        ++bitpos; // Upper 3 bits are shifted by 1
+      if(off & (1 << channel)) {
+        disable |= (1 << (TCA_SPLIT_LCMP0EN_bp + bitpos));
+        continue;
+      }
+      if(channel >= 3)
+        (&TCA0.SPLIT.HCMP0)[2*(channel-3)] = _pwm_staged_cmp[channel];
+      else
+        (&TCA0.SPLIT.LCMP0)[2*channel] = _pwm_staged_cmp[channel];
+      enable |= (1 << (TCA_SPLIT_LCMP0EN_bp + bitpos));
+    }
+  }
+  TCA0.SPLIT.CTRLB = (TCA0.SPLIT.CTRLB | enable) & ~disable;
+
+  _pwm_staged_mask = 0;
+  _pwm_staged_off = 0;
+  TCA0.SPLIT.INTCTRL &= ~TCA_SPLIT_LUNF_bm;
+  TCA0.SPLIT.INTFLAGS = TCA_SPLIT_LUNF_bm;
+}
@@ -2,6 +2,96 @@
 #include "pins_arduino.h"
 #include "wiring_private.h"
 
+volatile uint8_t _pwm_staged_cmp[6];
+volatile uint8_t _pwm_staged_mask;
+volatile uint8_t _pwm_staged_off;
+volatile uint8_t _pwm_update_active;
+
+// Compare value that keeps a single mode output constantly high
+static uint16_t tca0_single_high() {
+  uint16_t top = TCA0.SINGLE.PER;
+  return (top < 0xFFFF)? top + 1: top;
+}
+
+// Called with interrupts disabled
+static void tca0_split_enable(uint8_t channel, uint8_t enable) {
+  uint8_t enable_bm = 1 << (TCA_SPLIT_LCMP0EN_bp + channel + (channel >= 3)); // Upper 3 bits are shifted by 1
+  if(enable)
+    TCA0.SPLIT.CTRLB |= enable_bm;
+  else
+    TCA0.SPLIT.CTRLB &= ~enable_bm;
+}
+
+void tca0_write_compare(uint8_t channel, uint16_t value) {
+  uint8_t savedSREG = SREG;
+
+  if(!tca0_split_mode()) {
+    // Single mode is double buffered in hardware. The buffer is copied to the
+    // compare register at the next UPDATE event, or when pwmUpdateEnd()
+    // releases the lock. A channel that is currently off starts out holding
+    // the level of its port pin until then
+    uint8_t enable_bm = 1 << (TCA_SINGLE_CMP0EN_bp + channel);
+    cli();
+    if(!(TCA0.SINGLE.CTRLB & enable_bm)) {
+      VPORT_t *vport = &VPORTA + PORTMUX.TCAROUTEA;
+      (&TCA0.SINGLE.CMP0)[channel] = (vport->OUT & (1 << channel))? tca0_single_high(): 0;
+    }
+    (&TCA0.SINGLE.CMP0BUF)[channel] = value;
+    TCA0.SINGLE.CTRLB |= enable_bm;
+    SREG = savedSREG;
+    return;
+  }
+
+  // Split mode has no buffer registers, so values written inside an update
+  // block are kept in RAM until the next underflow
+  cli();
+  if(_pwm_update_active) {
+    _pwm_staged_cmp[channel] = value;
+    _pwm_staged_off &= ~(1 << channel);
+    _pwm_staged_mask |= (1 << channel);
+    SREG = savedSREG;
+    return;
+  }
+
+  // A value staged by an update block that hasn't been committed yet would
+  // overwrite this one
+  _pwm_staged_mask &= ~(1 << channel);
+  if (channel >= 3)
+    (&TCA0.SPLIT.HCMP0)[2*(channel-3)] = value;
+  else
+    (&TCA0.SPLIT.LCMP0)[2*channel] = value;
+  tca0_split_enable(channel, 1);
+  SREG = savedSREG;
+}
+
+void tca0_write_static(uint8_t channel, uint8_t high) {
+  if(!tca0_split_mode()) {
+    // Compare values at BOTTOM or above TOP give a static output level
+    tca0_write_compare(channel, high? tca0_single_high(): 0);
+    return;
+  }
+
+  // The output is released, and the port output value set by the caller
+  // takes over. Inside an update block this waits for the next underflow
+  uint8_t savedSREG = SREG;
+  cli();
+  if(_pwm_update_active) {
+    _pwm_staged_off |= (1 << channel);
+    _pwm_staged_mask |= (1 << channel);
+  } else {
+    _pwm_staged_mask &= ~(1 << channel);
+    tca0_split_enable(channel, 0);
+  }
+  SREG = savedSREG;
+}
+
+void tca0_drop_staged(uint8_t channel) {
+  uint8_t savedSREG = SREG;
+  cli();
+  _pwm_staged_mask &= ~(1 << channel);
+  SREG = savedSREG;
+}
+
 void pwmWrite(pwm_timers_t pwmTimer, uint16_t val, timers_route_t timerRoute) {
   // Set PORTMUX to route PWM to the correct pin
   if (timerRoute != ROUTE_UNTOUCHED) {
@@ -21,13 +111,17 @@ void pwmWrite(pwm_timers_t pwmTimer, uint16_t val, timers_route_t timerRoute) {
   // Find corresponding IO pin based on pwmTimer
   uint8_t route = 0;
   uint8_t pin_bp = 0;
-  uint8_t d_max = 0;
+  uint16_t d_max = 0;
   VPORT_t *vport;
+  bool tca_single = !tca0_split_mode();
   if(pwmTimer <= TCA0_5) {
+    // Single mode only has three 16-bit channels
+    if(tca_single && pwmTimer > TCA0_2)
+      return;
     route  = PORTMUX.TCAROUTEA;
     pin_bp = pwmTimer;
     vport  = &VPORTA + route;
-    d_max  = TCA0.SPLIT.LPER;
+    d_max  = tca_single? TCA0.SINGLE.PER: TCA0.SPLIT.LPER;
   } else if(pwmTimer == TCB_0) {
     route  = PORTMUX.TCBROUTEA & 0x01;
     pin_bp = route? PIN4_bp: PIN2_bp;
@@ -61,12 +155,17 @@ void pwmWrite(pwm_timers_t pwmTimer, uint16_t val, timers_route_t timerRoute) {
   
   TCB_t *timer_B;
   if(val <= 0 || val > d_max) {
+    // Set pin high or low. A TCA0 channel keeps driving the pin until the
+    // end of the current PWM period
+    if(val <= 0)
+      vport->OUT &= ~(1<<pin_bp);
+    else
+      vport->OUT |= (1<<pin_bp);
+
     // Turn off PWM
-    uint8_t bitpos = pin_bp;
     switch (pwmTimer) {
       case TCA0_0...TCA0_5:
-        if (bitpos >= 3) ++bitpos; // Upper 3 bits are shifted by 1
-        TCA0.SPLIT.CTRLB &= ~(1 << (TCA_SPLIT_LCMP0EN_bp + bitpos));
+        tca0_write_static(pin_bp, val > 0);
         break;
 
       case TCB_0:
@@ -82,30 +181,15 @@ void pwmWrite(pwm_timers_t pwmTimer, uint16_t val, timers_route_t timerRoute) {
       default:
         break;
     }
-    // Set pin high or low
-    if(val <= 0)
-      vport->OUT &= ~(1<<pin_bp);
-    else
-      vport->OUT |= (1<<pin_bp);
   }
 
   // Turn on PWM using the correct timer
   else {
-    uint8_t savedSREG = SREG;
-    uint8_t *timer_cmp_out;
+    uint8_t savedSREG;
 
     switch (pwmTimer) {
       case TCA0_0...TCA0_5:
-        if (pin_bp >= 3) {
-          timer_cmp_out = ((uint8_t *)(&TCA0.SPLIT.HCMP0)) + 2*(pin_bp-3);
-          ++pin_bp;
-        } else {
-          timer_cmp_out = ((uint8_t *)(&TCA0.SPLIT.LCMP0)) + 2*pin_bp;
-        }
-        cli();
-        *timer_cmp_out = val;
-        SREG = savedSREG;
-        TCA0.SPLIT.CTRLB |= (1 << (TCA_SPLIT_LCMP0EN_bp + pin_bp));
+        tca0_write_compare(pin_bp, val);
         break;
 
       case TCB_0:
@@ -136,9 +220,26 @@ void pwmPrescaler(pwm_timers_t pwmTimer, timers_prescaler_t prescaler) {
   }
 }
 
-void pwmSetResolution(pwm_timers_t pwmTimer, uint8_t maxValue) {
+void pwmSetResolution(pwm_timers_t pwmTimer, uint16_t maxValue) {
   // The max value will disable PWM and set pin high
-  uint8_t top = maxValue? maxValue-1: 1;
+  uint16_t top = maxValue? maxValue-1: 1;
+
+  if(pwmTimer <= TCA0_5 && !tca0_split_mode()) {
+    // Written to the buffer registers, so the new period starts at the next
+    // UPDATE event instead of cutting the current PWM cycle short
+    uint8_t savedSREG = SREG;
+    cli();
+    TCA0.SINGLE.PERBUF = top;
+    TCA0.SINGLE.CMP0BUF =
+      TCA0.SINGLE.CMP1BUF =
+        TCA0.SINGLE.CMP2BUF = top >> 1;
+    SREG = savedSREG;
+    return;
+  }
+
+  // 8-bit timers
+  if(top > 0xFF)
+    top = 0xFF;
 
   if(pwmTimer <= TCA0_5) {
     TCA0.SPLIT.LPER =
@@ -155,4 +256,48 @@ void pwmSetResolution(pwm_timers_t pwmTimer, uint8_t maxValue) {
     timer_B->CCMPH = top >> 1;
   }
     
-}
\ No newline at end of file
+}
+
+void pwmSetMode(tca_mode_t mode) {
+  // Keep the clock prescaler, since the TCBs may be clocked from TCA0
+  uint8_t clksel = TCA0.SINGLE.CTRLA & TCA_SINGLE_CLKSEL_gm;
+
+  // Outputs are released before the mode changes, so the PORTMUX route is
+  // left as is and the pins keeps their port output value until pwmWrite()
+  // or analogWrite() enables them again
+  TCA0.SINGLE.CTRLA = 0;
+  TCA0.SINGLE.CTRLESET = TCA_SINGLE_CMD_RESET_gc;
+  _pwm_staged_mask = 0;
+  _pwm_staged_off = 0;
+
+  if(mode == TCA_SINGLE_MODE) {
+    // The full 16-bit period is only a few Hz at the default prescaler, so
+    // use the largest period that gives at least 250 Hz at the current one
+    static const uint8_t clk_shift[] = {0, 1, 2, 3, 4, 6, 8, 10};
+    uint32_t period = (F_CPU >> clk_shift[clksel >> TCA_SINGLE_CLKSEL_gp]) / 250;
+    if(period > 0x10000)
+      period = 0x10000;
+    else if(period < 0x100)
+      period = 0x100;
+
+    TCA0.SINGLE.CTRLD = 0;
+    TCA0.SINGLE.CTRLB = TCA_SINGLE_WGMODE_SINGLESLOPE_gc;
+    TCA0.SINGLE.PER = period - 1;
+    TCA0.SINGLE.CMP0 =
+      TCA0.SINGLE.CMP1 =
+        TCA0.SINGLE.CMP2 = period >> 1;
+  } else {
+    // Same as setup_timers() in wiring.c
+    TCA0.SPLIT.CTRLD = TCA_SINGLE_SPLITM_bm;
+    TCA0.SPLIT.LPER =
+      TCA0.SPLIT.HPER = PWM_TIMER_PERIOD;
+    TCA0.SPLIT.LCMP0 =
+      TCA0.SPLIT.LCMP1 =
+        TCA0.SPLIT.LCMP2 =
+          TCA0.SPLIT.HCMP0 =
+            TCA0.SPLIT.HCMP1 =
+              TCA0.SPLIT.HCMP2 = PWM_TIMER_COMPARE;
+  }
+
+  TCA0.SINGLE.CTRLA = clksel | TCA_SINGLE_ENABLE_bm;
+}
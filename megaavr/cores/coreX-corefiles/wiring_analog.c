@@ -109,7 +109,18 @@ void analogWrite(uint8_t pin, int val)
   // call for the analog output pins.
   pinMode(pin, OUTPUT);
 
-  if (val <= 0)
+  if ((val <= 0 || val >= 255) && digitalPinToTimer(pin) == TIMERA0
+      && (tca0_split_mode() || bit_pos < 3))
+  { /* TCA0 channels are turned fully on or off like any other duty cycle
+       change, so this is held back inside an update block too */
+    PORT_t *port = digitalPinToPortStruct(pin);
+    if (val <= 0)
+      port->OUTCLR = 1 << bit_pos;
+    else
+      port->OUTSET = 1 << bit_pos;
+    tca0_write_static(bit_pos, val > 0);
+  }
+  else if (val <= 0)
   { /* if zero or negative drive digital low */
     digitalWrite(pin, LOW);
   }
@@ -123,7 +134,6 @@ void analogWrite(uint8_t pin, int val)
     /* Get timer */
     uint8_t digital_pin_timer = digitalPinToTimer(pin);
 
-    uint8_t *timer_cmp_out;
     TCB_t *timer_B;
 
     uint8_t savedSREG;
@@ -132,26 +142,22 @@ void analogWrite(uint8_t pin, int val)
     switch (digital_pin_timer)
     {
       case TIMERA0:
-        /* Split mode, 2x3 8 bit registers. (chapter 19.7) */
-        if (bit_pos >= 3)
-        {
-          timer_cmp_out = ((uint8_t *)(&TCA0.SPLIT.HCMP0)) + 2 * (bit_pos - 3);
-          ++bit_pos; /* Upper 3 bits are shifted by 1 */
-        }
-        else
+        if (!tca0_split_mode())
         {
-          /* Calculate correct compare buffer register */
-          timer_cmp_out = ((uint8_t *)(&TCA0.SPLIT.LCMP0)) + 2 * bit_pos;
+          /* Single mode, 3 16 bit registers. Only WO0-2 are available */
+          if (bit_pos >= 3)
+          {
+            digitalWrite(pin, (val >= 128) ? HIGH : LOW);
+            break;
+          }
+
+          /* Scale duty cycle to the 16-bit period */
+          tca0_write_compare(bit_pos, ((uint32_t)val * TCA0.SINGLE.PER) / 255);
+          break;
         }
 
-        /* Configure duty cycle for correct compare channel */
-        savedSREG = SREG;
-        cli();
-        (*timer_cmp_out) = (val); // non-atomic 16-bit write operation
-        SREG = savedSREG;
-
-        /* Enable output on pin */
-        TCA0.SPLIT.CTRLB |= (1 << (TCA_SPLIT_LCMP0EN_bp + bit_pos));
+        /* Split mode, 2x3 8 bit registers. (chapter 19.7) */
+        tca0_write_compare(bit_pos, val);
         break;
 
       case TIMERB0:
@@ -109,6 +109,16 @@ static void turnOffPWM(uint8_t pin)
       bit_pos = digitalPinToBitPosition(pin);
 
       /* Disable corresponding channel */
+      if (!tca0_split_mode())
+      {
+        /* Single mode only has three outputs */
+        if (bit_pos < 3)
+          TCA0.SINGLE.CTRLB &= ~(1 << (TCA_SINGLE_CMP0EN_bp + bit_pos));
+        break;
+      }
+      /* Drop any value staged for this channel, so the underflow interrupt
+         doesn't turn it back on */
+      tca0_drop_staged(bit_pos);
       if (bit_pos >= 3) ++bit_pos; /* Upper 3 bits are shifted by 1 */
       TCA0.SPLIT.CTRLB &= ~(1 << (TCA_SPLIT_LCMP0EN_bp + bit_pos));
 
@@ -202,28 +212,6 @@ void digitalWrite(uint8_t pin, uint8_t val)
   }
 }
 
-inline __attribute__((always_inline)) void digitalWriteFast(uint8_t pin, uint8_t val)
-{
-  // Make sure pin is constant and know at compile time
-  check_constant_pin(pin);
-
-  // Mega-0, Tiny-1 style IOPORTs
-  // Assumes VPORTs exist starting at 0 for each PORT structure
-  uint8_t mask = 1 << digital_pin_to_bit_position[pin];
-  uint8_t port = digital_pin_to_port[pin];
-  VPORT_t *vport;
-
-  // Write pin value from VPORTx.OUT register
-  vport = (VPORT_t *)(port * 4);
-
-  if (val == HIGH)
-    vport->OUT |= mask;
-  else if (val == LOW)
-    vport->OUT &= ~mask;
-  else // CHANGE
-    vport->IN = mask;
-}
-
 uint8_t digitalRead(uint8_t pin)
 {
   /* Get bit mask and check valid pin */
@@ -247,20 +235,91 @@ uint8_t digitalRead(uint8_t pin)
   return LOW;
 }
 
-inline __attribute__((always_inline)) uint8_t digitalReadFast(uint8_t pin)
+// Slow paths of the inline digitalWrite() and digitalRead() in Arduino.h
+void _digitalWrite(uint8_t pin, uint8_t val) __attribute__((alias("digitalWrite")));
+uint8_t _digitalRead(uint8_t pin) __attribute__((alias("digitalRead")));
+
+void portWrite(uint8_t port, uint8_t mask, uint8_t value)
+{
+  if (port >= NUM_TOTAL_PORTS)
+    return;
+
+  VPORT_t *vport = &VPORTA + port;
+
+  /* Read-modify-write with interrupts disabled, so all masked bits
+  change on the same clock edge */
+  uint8_t status = SREG;
+  cli();
+  vport->OUT = (vport->OUT & ~mask) | (value & mask);
+  SREG = status;
+}
+
+uint8_t portRead(uint8_t port, uint8_t mask)
+{
+  if (port >= NUM_TOTAL_PORTS)
+    return 0;
+
+  return (&VPORTA + port)->IN & mask;
+}
+
+void portSet(uint8_t port, uint8_t mask)
 {
-  // Make sure pin is constant and know at compile time
-  check_constant_pin(pin);
+  PORT_t *portStruct = portToPortStruct(port);
+  if (portStruct == NULL)
+    return;
 
-  // Mega-0, Tiny-1 style IOPORTs
-  // Assumes VPORTs exist starting at 0 for each PORT structure
-  uint8_t mask = 1 << digital_pin_to_bit_position[pin];
-  uint8_t port = digital_pin_to_port[pin];
-  VPORT_t *vport;
+  portStruct->OUTSET = mask;
+}
 
-  // Old style port logic is a small integer 0 for PORTA, 1 for PORTB etc.
-  vport = (VPORT_t *)(port * 4);
+void portClear(uint8_t port, uint8_t mask)
+{
+  PORT_t *portStruct = portToPortStruct(port);
+  if (portStruct == NULL)
+    return;
+
+  portStruct->OUTCLR = mask;
+}
+
+void portToggle(uint8_t port, uint8_t mask)
+{
+  PORT_t *portStruct = portToPortStruct(port);
+  if (portStruct == NULL)
+    return;
+
+  portStruct->OUTTGL = mask;
+}
+
+void portMode(uint8_t port, uint8_t mask, uint8_t mode)
+{
+  PORT_t *portStruct = portToPortStruct(port);
+  if ((portStruct == NULL) || (mode > INPUT_PULLUP))
+    return;
+
+  if (mode == OUTPUT)
+  {
+    portStruct->DIRSET = mask;
+    return;
+  }
+
+  /* Save state */
+  uint8_t status = SREG;
+  cli();
+
+  portStruct->DIRCLR = mask;
+
+  /* Configure pull-up resistor for every pin in the mask */
+  volatile uint8_t *pin_ctrl_reg = &portStruct->PIN0CTRL;
+  for (uint8_t bit_mask = PIN0_bm; bit_mask; bit_mask <<= 1, pin_ctrl_reg++)
+  {
+    if (!(mask & bit_mask))
+      continue;
+
+    if (mode == INPUT_PULLUP)
+      *pin_ctrl_reg |= PORT_PULLUPEN_bm;
+    else
+      *pin_ctrl_reg &= ~(PORT_PULLUPEN_bm);
+  }
 
-  // Read pin value from VPORTx.IN register
-  return !!(vport->IN & mask);
+  /* Restore state */
+  SREG = status;
 }
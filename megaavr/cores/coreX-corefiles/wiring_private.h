@@ -39,6 +39,32 @@ extern "C"
 
   typedef void (*voidFuncPtr)(void);
 
+  // TCA0 runs in split mode (six 8-bit PWM channels) unless pwmSetMode() has
+  // changed it to single mode (three 16-bit PWM channels)
+  static inline uint8_t tca0_split_mode(void)
+  {
+    return TCA0.SINGLE.CTRLD & TCA_SINGLE_SPLITM_bm;
+  }
+
+  // Writes the compare value of TCA0 channel 0-5 (0-2 in single mode) and
+  // enables its output. Staged until pwmUpdateEnd() inside an update block
+  void tca0_write_compare(uint8_t channel, uint16_t value);
+
+  // Same as tca0_write_compare(), but turns the channel fully on or off
+  void tca0_write_static(uint8_t channel, uint8_t high);
+
+  // Drops a split mode value staged for the channel, used when digitalWrite()
+  // takes the pin over
+  void tca0_drop_staged(uint8_t channel);
+
+  // Split mode values staged inside an update block, copied to the compare
+  // registers by the TCA0 underflow interrupt. Channels in _pwm_staged_off
+  // have their output released instead
+  extern volatile uint8_t _pwm_staged_cmp[6];
+  extern volatile uint8_t _pwm_staged_mask;
+  extern volatile uint8_t _pwm_staged_off;
+  extern volatile uint8_t _pwm_update_active;
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -1,5 +1,5 @@
 /*
-  wiring_shift.c - shiftOut() function
+  wiring_shift.c - shiftOut() and shiftIn() functions
   Part of Arduino - http://www.arduino.cc/
 
   Copyright (c) 2005-2006 David A. Mellis
@@ -22,35 +22,247 @@
 
 #include "Arduino.h"
 
-uint8_t shiftIn(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder)
+/*
+ * shiftOut() and shiftIn() use SPI0 or a USART in master SPI mode when the
+ * data and clock pins match a peripheral pin route, and the peripheral isn't
+ * already in use. The peripheral is only borrowed for the duration of the
+ * transfer, and the PORTMUX setting is restored afterwards.
+ * Everything else is bit-banged directly on the PORT registers.
+ *
+ * shiftOut() outputs data before the rising clock edge, and shiftIn() samples
+ * data after the rising clock edge, with the clock idling low. This matches
+ * SPI mode 0 and mode 1.
+ */
+
+typedef struct
 {
-  uint8_t value = 0;
-  uint8_t i;
+  uint8_t mosi_pin;
+  uint8_t miso_pin;
+  uint8_t sck_pin;
+  uint8_t mux;
+} shift_spi_route_t;
+
+typedef struct
+{
+  volatile USART_t *usart;
+  uint8_t tx_pin;
+  uint8_t rx_pin;
+  uint8_t xck_pin;
+  uint8_t mux;
+} shift_usart_route_t;
+
+static const shift_spi_route_t shift_spi_routes[] = {
+#if defined(SPI_MUX) && defined(PIN_SPI_SCK)
+  { PIN_SPI_MOSI, PIN_SPI_MISO, PIN_SPI_SCK, SPI_MUX },
+#endif
+#if defined(SPI_MUX_PINSWAP_1) && defined(PIN_SPI_SCK_PINSWAP_1)
+  { PIN_SPI_MOSI_PINSWAP_1, PIN_SPI_MISO_PINSWAP_1, PIN_SPI_SCK_PINSWAP_1, SPI_MUX_PINSWAP_1 },
+#endif
+#if defined(SPI_MUX_PINSWAP_2) && defined(PIN_SPI_SCK_PINSWAP_2)
+  { PIN_SPI_MOSI_PINSWAP_2, PIN_SPI_MISO_PINSWAP_2, PIN_SPI_SCK_PINSWAP_2, SPI_MUX_PINSWAP_2 },
+#endif
+};
+
+static const shift_usart_route_t shift_usart_routes[] = {
+#if defined(HWSERIAL0) && defined(PIN_HWSERIAL0_XCK)
+  { HWSERIAL0, PIN_HWSERIAL0_TX, PIN_HWSERIAL0_RX, PIN_HWSERIAL0_XCK, HWSERIAL0_MUX },
+#endif
+#if defined(HWSERIAL0) && defined(PIN_HWSERIAL0_XCK_PINSWAP_1)
+  { HWSERIAL0, PIN_HWSERIAL0_TX_PINSWAP_1, PIN_HWSERIAL0_RX_PINSWAP_1, PIN_HWSERIAL0_XCK_PINSWAP_1, HWSERIAL0_MUX_PINSWAP_1 },
+#endif
+#if defined(HWSERIAL1) && defined(PIN_HWSERIAL1_XCK)
+  { HWSERIAL1, PIN_HWSERIAL1_TX, PIN_HWSERIAL1_RX, PIN_HWSERIAL1_XCK, HWSERIAL1_MUX },
+#endif
+#if defined(HWSERIAL1) && defined(PIN_HWSERIAL1_XCK_PINSWAP_1)
+  { HWSERIAL1, PIN_HWSERIAL1_TX_PINSWAP_1, PIN_HWSERIAL1_RX_PINSWAP_1, PIN_HWSERIAL1_XCK_PINSWAP_1, HWSERIAL1_MUX_PINSWAP_1 },
+#endif
+#if defined(HWSERIAL2) && defined(PIN_HWSERIAL2_XCK)
+  { HWSERIAL2, PIN_HWSERIAL2_TX, PIN_HWSERIAL2_RX, PIN_HWSERIAL2_XCK, HWSERIAL2_MUX },
+#endif
+#if defined(HWSERIAL2) && defined(PIN_HWSERIAL2_XCK_PINSWAP_1)
+  { HWSERIAL2, PIN_HWSERIAL2_TX_PINSWAP_1, PIN_HWSERIAL2_RX_PINSWAP_1, PIN_HWSERIAL2_XCK_PINSWAP_1, HWSERIAL2_MUX_PINSWAP_1 },
+#endif
+#if defined(HWSERIAL3) && defined(PIN_HWSERIAL3_XCK)
+  { HWSERIAL3, PIN_HWSERIAL3_TX, PIN_HWSERIAL3_RX, PIN_HWSERIAL3_XCK, HWSERIAL3_MUX },
+#endif
+#if defined(HWSERIAL3) && defined(PIN_HWSERIAL3_XCK_PINSWAP_1)
+  { HWSERIAL3, PIN_HWSERIAL3_TX_PINSWAP_1, PIN_HWSERIAL3_RX_PINSWAP_1, PIN_HWSERIAL3_XCK_PINSWAP_1, HWSERIAL3_MUX_PINSWAP_1 },
+#endif
+};
+
+// Check if a pin the peripheral takes over, but the transfer doesn't need, is set as output
+static uint8_t pin_is_output(uint8_t pin)
+{
+  uint8_t bit_mask = digitalPinToBitMask(pin);
+  if (bit_mask == NOT_A_PIN)
+    return 0;
+  return digitalPinToPortStruct(pin)->DIR & bit_mask;
+}
+
+static uint8_t shift_spi(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, const uint8_t *out, uint8_t *in, size_t len)
+{
+  for (uint8_t i = 0; i < sizeof(shift_spi_routes) / sizeof(shift_spi_routes[0]); i++)
+  {
+    const shift_spi_route_t *route = &shift_spi_routes[i];
+    if (clockPin != route->sck_pin || dataPin != (out ? route->mosi_pin : route->miso_pin))
+      continue;
+
+    // Leave SPI alone if the SPI library is using it. In master mode MISO
+    // is forced to input, and MOSI is driven if it's an output
+    if ((SPI0.CTRLA & SPI_ENABLE_bm) || pin_is_output(out ? route->miso_pin : route->mosi_pin))
+      return 0;
+
+    uint8_t mux = PORTMUX.TWISPIROUTEA;
+    PORTMUX.TWISPIROUTEA = route->mux | (mux & ~PORTMUX_SPI0_gm);
+
+    SPI0.CTRLB = SPI_SSD_bm | (out ? SPI_MODE_0_gc : SPI_MODE_1_gc);
+    SPI0.CTRLA = SPI_MASTER_bm | SPI_PRESC_DIV4_gc | SPI_ENABLE_bm | (bitOrder == LSBFIRST ? SPI_DORD_bm : 0);
 
-  for (i = 0; i < 8; ++i)
+    while (len--)
+    {
+      SPI0.DATA = out ? *out++ : 0;
+      while (!(SPI0.INTFLAGS & SPI_IF_bm));
+      uint8_t data = SPI0.DATA;
+      if (in)
+        *in++ = data;
+    }
+
+    SPI0.CTRLA = 0;
+    PORTMUX.TWISPIROUTEA = mux;
+    return 1;
+  }
+  return 0;
+}
+
+static uint8_t shift_usart(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, const uint8_t *out, uint8_t *in, size_t len)
+{
+  for (uint8_t i = 0; i < sizeof(shift_usart_routes) / sizeof(shift_usart_routes[0]); i++)
   {
-    digitalWrite(clockPin, HIGH);
-    if (bitOrder == LSBFIRST)
-      value |= digitalRead(dataPin) << i;
+    const shift_usart_route_t *route = &shift_usart_routes[i];
+    if (clockPin != route->xck_pin || dataPin != (out ? route->tx_pin : route->rx_pin))
+      continue;
+
+    // Leave the USART alone if Serial is using it. The transmitter is
+    // needed to generate the clock, and drives TX if it's an output
+    volatile USART_t *usart = route->usart;
+    if ((usart->CTRLB & (USART_RXEN_bm | USART_TXEN_bm)) || (in && pin_is_output(route->tx_pin)))
+      return 0;
+
+    // USART0-3 are 0x20 bytes apart, with two PORTMUX bits each
+    uint8_t mux_mask = PORTMUX_USART0_gm << ((((uint16_t)usart >> 5) & 0x03) * 2);
+    uint8_t mux = PORTMUX.USARTROUTEA;
+    PORTMUX.USARTROUTEA = route->mux | (mux & ~mux_mask);
+
+    // F_CPU/4, same as SPI
+    usart->BAUD = 2 << 6;
+    usart->CTRLC = USART_CMODE_MSPI_gc | (bitOrder == LSBFIRST ? USART_UDORD_bm : 0) | (out ? 0 : USART_UCPHA_bm);
+    usart->STATUS = USART_TXCIF_bm;
+    usart->CTRLB = USART_TXEN_bm | (in ? USART_RXEN_bm : 0);
+
+    while (len--)
+    {
+      while (!(usart->STATUS & USART_DREIF_bm));
+      usart->TXDATAL = out ? *out++ : 0;
+      if (in)
+      {
+        while (!(usart->STATUS & USART_RXCIF_bm));
+        *in++ = usart->RXDATAL;
+      }
+    }
+    while (!(usart->STATUS & USART_TXCIF_bm));
+
+    usart->CTRLB = 0;
+    PORTMUX.USARTROUTEA = mux;
+    return 1;
+  }
+  return 0;
+}
+
+#define SHIFT_OUT_BIT(bit)                         \
+  if (val & (bit))                                 \
+    data_port->OUTSET = data_mask;                 \
+  else                                             \
+    data_port->OUTCLR = data_mask;                 \
+  clock_port->OUTSET = clock_mask;                 \
+  _NOP();                                          \
+  clock_port->OUTCLR = clock_mask;
+
+#define SHIFT_IN_BIT(bit)                          \
+  clock_port->OUTSET = clock_mask;                 \
+  _NOP();                                          \
+  if (data_port->IN & data_mask)                   \
+    val |= (bit);                                  \
+  clock_port->OUTCLR = clock_mask;
+
+static void shift_soft(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, const uint8_t *out, uint8_t *in, size_t len)
+{
+  uint8_t data_mask = digitalPinToBitMask(dataPin);
+  uint8_t clock_mask = digitalPinToBitMask(clockPin);
+  if (data_mask == NOT_A_PIN || clock_mask == NOT_A_PIN)
+    return;
+
+  PORT_t *data_port = digitalPinToPortStruct(dataPin);
+  PORT_t *clock_port = digitalPinToPortStruct(clockPin);
+
+  while (len--)
+  {
+    uint8_t val;
+    if (out)
+    {
+      val = *out++;
+      if (bitOrder == LSBFIRST)
+      {
+        SHIFT_OUT_BIT(0x01) SHIFT_OUT_BIT(0x02) SHIFT_OUT_BIT(0x04) SHIFT_OUT_BIT(0x08)
+        SHIFT_OUT_BIT(0x10) SHIFT_OUT_BIT(0x20) SHIFT_OUT_BIT(0x40) SHIFT_OUT_BIT(0x80)
+      }
+      else
+      {
+        SHIFT_OUT_BIT(0x80) SHIFT_OUT_BIT(0x40) SHIFT_OUT_BIT(0x20) SHIFT_OUT_BIT(0x10)
+        SHIFT_OUT_BIT(0x08) SHIFT_OUT_BIT(0x04) SHIFT_OUT_BIT(0x02) SHIFT_OUT_BIT(0x01)
+      }
+    }
     else
-      value |= digitalRead(dataPin) << (7 - i);
-    digitalWrite(clockPin, LOW);
+    {
+      val = 0;
+      if (bitOrder == LSBFIRST)
+      {
+        SHIFT_IN_BIT(0x01) SHIFT_IN_BIT(0x02) SHIFT_IN_BIT(0x04) SHIFT_IN_BIT(0x08)
+        SHIFT_IN_BIT(0x10) SHIFT_IN_BIT(0x20) SHIFT_IN_BIT(0x40) SHIFT_IN_BIT(0x80)
+      }
+      else
+      {
+        SHIFT_IN_BIT(0x80) SHIFT_IN_BIT(0x40) SHIFT_IN_BIT(0x20) SHIFT_IN_BIT(0x10)
+        SHIFT_IN_BIT(0x08) SHIFT_IN_BIT(0x04) SHIFT_IN_BIT(0x02) SHIFT_IN_BIT(0x01)
+      }
+      *in++ = val;
+    }
   }
+}
+
+static void shift(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, const uint8_t *out, uint8_t *in, size_t len)
+{
+  if (!shift_spi(dataPin, clockPin, bitOrder, out, in, len) && !shift_usart(dataPin, clockPin, bitOrder, out, in, len))
+    shift_soft(dataPin, clockPin, bitOrder, out, in, len);
+}
+
+uint8_t shiftIn(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder)
+{
+  uint8_t value = 0;
+  shift(dataPin, clockPin, bitOrder, NULL, &value, 1);
   return value;
 }
 
 void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val)
 {
-  uint8_t i;
+  shift(dataPin, clockPin, bitOrder, &val, NULL, 1);
+}
 
-  for (i = 0; i < 8; i++)
-  {
-    if (bitOrder == LSBFIRST)
-      digitalWrite(dataPin, !!(val & (1 << i)));
-    else
-      digitalWrite(dataPin, !!(val & (1 << (7 - i))));
+void shiftInBuffer(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t *buf, size_t len)
+{
+  shift(dataPin, clockPin, bitOrder, NULL, buf, len);
+}
 
-    digitalWrite(clockPin, HIGH);
-    digitalWrite(clockPin, LOW);
-  }
+void shiftOutBuffer(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, const uint8_t *buf, size_t len)
+{
+  shift(dataPin, clockPin, bitOrder, buf, NULL, len);
 }
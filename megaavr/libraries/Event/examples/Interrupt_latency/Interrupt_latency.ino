@@ -0,0 +1,205 @@
+/***********************************************************************|
+| megaAVR event system library                                          |
+|                                                                       |
+| Interrupt_latency.ino                                                 |
+|                                                                       |
+| A library for interfacing with the megaAVR event system.              |
+| Developed in 2021 by MCUdude                                          |
+| https://github.com/MCUdude/                                           |
+|                                                                       |
+| In this example we use the event system and a TCB in input capture    |
+| mode to measure interrupt latency in CPU cycles, without any          |
+| external hardware. Pin PD2 is used as both an output and an event     |
+| generator. When the sketch toggles the pin, the event channel makes   |
+| the TCB capture its counter at the exact clock cycle of the edge,     |
+| while the pin interrupt fires the callback. The callback reads the    |
+| counter again, and the difference is the edge-to-callback latency.    |
+|                                                                       |
+| The worst case time each core ISR steals from the main loop (the      |
+| millis timer, the UART and the port interrupt) is measured by         |
+| polling the counter in a tight loop and recording the largest gap.    |
+| Serial1 is put in loopback mode, so its TX and RX interrupts can be   |
+| measured without anything connected to the TX/RX pins.                |
+|                                                                       |
+| All results are printed in CPU cycles over Serial, one result per     |
+| line, so they're easy to compare between core versions.               |
+|                                                                       |
+| Note that PD2 and Serial1's TX pin are driven by this sketch. PD2 is  |
+| free on all MegaCoreX pinouts, unlike PA1 (Serial RX on most).        |
+|***********************************************************************/
+
+#include <Event.h>
+
+// Timer used as cycle counter. Can't be the one used for millis
+#if defined(MILLIS_USE_TIMERB0)
+  #define BENCH_TCB      TCB1
+  #define BENCH_TCB_USER event::user::tcb1_capt
+#else
+  #define BENCH_TCB      TCB0
+  #define BENCH_TCB_USER event::user::tcb0_capt
+#endif
+
+// Timer used for millis, see wiring.c
+#if defined(MILLIS_USE_TIMERB0)
+  #define MILLIS_TCB TCB0
+#elif defined(MILLIS_USE_TIMERB1)
+  #define MILLIS_TCB TCB1
+#elif defined(MILLIS_USE_TIMERB2)
+  #define MILLIS_TCB TCB2
+#else
+  #define MILLIS_TCB TCB3
+#endif
+
+const uint8_t testPin = PIN_PD2;
+const uint8_t iterations = 64;
+
+volatile uint16_t callbackCount;
+volatile bool callbackFired;
+
+struct result_t
+{
+  uint16_t min = 0xFFFF;
+  uint16_t max = 0;
+  uint32_t sum = 0;
+  uint8_t  count = 0;
+
+  void add(uint16_t cycles)
+  {
+    if(cycles < min)
+      min = cycles;
+    if(cycles > max)
+      max = cycles;
+    sum += cycles;
+    count++;
+  }
+};
+
+void pinCallback()
+{
+  // First instruction after the dispatcher calls us
+  callbackCount = BENCH_TCB.CNT;
+  callbackFired = true;
+}
+
+void printResult(const char *name, const result_t &r)
+{
+  Serial.printf(F("%-34s min %5u  avg %5u  max %5u  jitter %5u\n"), name, r.min,
+                (uint16_t)(r.sum / r.count), r.max, r.max - r.min);
+}
+
+// Largest number of cycles between two counter reads in a tight loop,
+// minus the time the loop itself takes
+uint16_t worstGap(uint16_t loops)
+{
+  uint16_t maxGap = 0;
+  uint16_t minGap = 0xFFFF;
+  uint16_t prev = BENCH_TCB.CNT;
+  while(loops--)
+  {
+    uint16_t now = BENCH_TCB.CNT;
+    uint16_t gap = now - prev;
+    if(gap > maxGap)
+      maxGap = gap;
+    if(gap < minGap)
+      minGap = gap;
+    prev = now;
+  }
+  return maxGap - minGap;
+}
+
+void setup()
+{
+  Serial.begin(115200);
+  Serial.printf(F("\nInterrupt latency benchmark, F_CPU = %lu Hz, results in CPU cycles\n"), F_CPU);
+
+  // Free running counter at CPU clock. In input capture mode CCMP gets a
+  // copy of CNT whenever an event arrives
+  BENCH_TCB.CTRLA = 0;
+  BENCH_TCB.CTRLB = TCB_CNTMODE_CAPT_gc;
+  BENCH_TCB.EVCTRL = TCB_CAPTEI_bm;
+  BENCH_TCB.INTCTRL = 0;
+  BENCH_TCB.CCMP = 0;
+  BENCH_TCB.CNT = 0;
+  BENCH_TCB.CTRLA = TCB_CLKSEL_CLKDIV1_gc | TCB_ENABLE_bm;
+
+  // Route the test pin to the timer capture input
+  pinMode(testPin, OUTPUT);
+  digitalWrite(testPin, LOW);
+  Event &benchEvent = Event::assign_generator_pin(testPin);
+  benchEvent.set_user(BENCH_TCB_USER);
+  benchEvent.start();
+
+  // Make sure nothing is left in the Serial TX buffer before measuring
+  Serial.flush();
+
+  // Run without the millis interrupt to get clean numbers
+  MILLIS_TCB.INTCTRL = 0;
+
+  // Cost of the measurement itself: toggle the pin with no interrupt attached
+  result_t baseline;
+  for(uint8_t i = 0; i < iterations; i++)
+  {
+    uint16_t t0 = BENCH_TCB.CNT;
+    digitalWriteFast(testPin, CHANGE);
+    uint16_t t1 = BENCH_TCB.CNT;
+    baseline.add(t1 - t0);
+  }
+
+  attachInterrupt(testPin, pinCallback, RISING);
+
+  result_t latency, epilogue, total;
+  for(uint8_t i = 0; i < iterations; i++)
+  {
+    digitalWriteFast(testPin, LOW);
+    callbackFired = false;
+    uint16_t t0 = BENCH_TCB.CNT;
+    digitalWriteFast(testPin, HIGH);
+    while(!callbackFired); // The edge takes a few cycles to reach the interrupt controller
+    uint16_t t1 = BENCH_TCB.CNT;
+    latency.add(callbackCount - BENCH_TCB.CCMP);
+    epilogue.add(t1 - callbackCount);
+    total.add(t1 - t0 - baseline.min);
+  }
+
+  // Gaps seen by the main loop while the pin interrupt fires
+  uint16_t portGap = 0;
+  for(uint8_t i = 0; i < iterations; i++)
+  {
+    digitalWriteFast(testPin, CHANGE);
+    uint16_t gap = worstGap(16);
+    if(gap > portGap)
+      portGap = gap;
+  }
+
+  detachInterrupt(testPin);
+  uint16_t idleGap = worstGap(4096);
+
+  // The millis interrupt alone
+  MILLIS_TCB.INTFLAGS = TCB_CAPT_bm;
+  MILLIS_TCB.INTCTRL = TCB_CAPT_bm;
+  uint16_t millisGap = worstGap(8192);
+  MILLIS_TCB.INTCTRL = 0;
+
+  // Serial1 TX and RX interrupts, with the transmitter looped back to the receiver
+  Serial1.begin(1000000);
+  (HWSERIAL1)->CTRLA |= USART_LBME_bm;
+  for(uint8_t i = 0; i < 16; i++)
+    Serial1.write(i);
+  uint16_t uartGap = worstGap(8192);
+  Serial1.flush();
+  Serial1.end();
+  MILLIS_TCB.INTCTRL = TCB_CAPT_bm;
+
+  printResult("Pin edge to callback", latency);
+  printResult("Callback to main loop", epilogue);
+  printResult("Total cost per pin interrupt", total);
+  Serial.printf(F("%-34s %5u\n"), "Idle loop jitter", idleGap);
+  Serial.printf(F("%-34s %5u\n"), "Port interrupt worst case", portGap);
+  Serial.printf(F("%-34s %5u\n"), "millis interrupt worst case", millisGap);
+  Serial.printf(F("%-34s %5u\n"), "Serial1 interrupts worst case", uartGap);
+}
+
+void loop()
+{
+
+}
@@ -0,0 +1,67 @@
+/***********************************************************************|
+| megaAVR input capture library                                         |
+|                                                                       |
+| Frequency_meter.ino                                                   |
+|                                                                       |
+| A library for measuring signals using the TCB input capture.          |
+| Developed in 2021 by MCUdude                                          |
+| https://github.com/MCUdude/                                           |
+|                                                                       |
+| In this example we measure the frequency of two signals at the same   |
+| time, for instance two flow meters, without blocking the main loop.   |
+| Each signal uses its own TCB timer, and is routed to the timer        |
+| through an event channel. The first signal is polled using            |
+| available(), and the second one uses a callback that runs from the    |
+| timer interrupt.                                                      |
+|                                                                       |
+| The timers are clocked from TCA0 (250kHz), which means signals down   |
+| to ~4Hz can be measured. Use capture::clock::div1 for faster signals. |
+|                                                                       |
+| See Microchip's technical brief TB3214 for more information.          |
+|***********************************************************************/
+
+#include <InputCapture.h>
+
+volatile uint32_t pulseCount;
+
+void countPulse(uint16_t period, uint16_t pulse_width)
+{
+  pulseCount++;
+}
+
+void setup()
+{
+  Serial.begin(9600);
+
+  pinMode(PIN_PA1, INPUT_PULLUP);
+  pinMode(PIN_PC1, INPUT_PULLUP);
+
+  InputCapture0.clock = capture::clock::tca0;
+  InputCapture0.filter = true; // Filter out noise
+  InputCapture0.begin(PIN_PA1);
+
+  InputCapture1.clock = capture::clock::tca0;
+  InputCapture1.attachInterrupt(countPulse);
+  InputCapture1.begin(PIN_PC1);
+}
+
+void loop()
+{
+  if(InputCapture0.available())
+  {
+    Serial.print(F("Flow meter 0: "));
+    Serial.print(InputCapture0.frequency());
+    Serial.print(F(" Hz, duty cycle "));
+    Serial.print(InputCapture0.dutyCycle());
+    Serial.println(F("%"));
+  }
+
+  static uint32_t lastPrint;
+  if(millis() - lastPrint >= 1000)
+  {
+    lastPrint = millis();
+    Serial.print(F("Flow meter 1: "));
+    Serial.print(pulseCount);
+    Serial.println(F(" measurements"));
+  }
+}
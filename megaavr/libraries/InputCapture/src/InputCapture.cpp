@@ -0,0 +1,182 @@
+#include "InputCapture.h"
+
+InputCapture::InputCapture(const uint8_t timer_number, TCB_t& tcb, event::user::user_t user)
+  : timer_number(timer_number), TCB(tcb), user(user)
+{
+}
+
+/**
+ * @brief Connects a pin to the timer through an event channel, and starts
+ *        measuring period and pulse width in the background.
+ *        The period is measured from rising edge to rising edge, and the pulse
+ *        width is the high time. Both must fit in 16 bits, so pick a clock
+ *        that's slow enough for the lowest frequency you need to measure
+ *
+ * @param pin Arduino pin to measure
+ * @return true if an event channel was available for the pin
+ */
+bool InputCapture::begin(uint8_t pin)
+{
+  Event& channel = Event::assign_generator_pin(pin);
+  if(channel.get_channel_number() == 255)
+    return false;
+  event_channel = &channel;
+
+  TCB.CTRLA = 0;
+  TCB.INTCTRL = 0;
+
+  // Frequency and pulse width measurement mode. A rising edge starts the
+  // counter, a falling edge captures the pulse width into CCMP, and the next
+  // rising edge stops the counter with the period in CNT
+  TCB.CTRLB = TCB_CNTMODE_FRQPW_gc;
+  TCB.EVCTRL = TCB_CAPTEI_bm | (filter ? TCB_FILTER_bm : 0);
+  TCB.CNT = 0;
+
+  new_capture = false;
+  TCB.INTFLAGS = TCB_CAPT_bm;
+  TCB.INTCTRL = TCB_CAPT_bm;
+  TCB.CTRLA = clock | TCB_ENABLE_bm;
+
+  event_channel->set_user(user);
+  event_channel->start();
+  return true;
+}
+
+/**
+ * @brief Stops the measurement, releases the event channel and puts the
+ *        timer back in the state analogWrite() expects
+ */
+void InputCapture::end()
+{
+  TCB.INTCTRL = 0;
+  TCB.CTRLA = 0;
+
+  if(event_channel)
+  {
+    Event::clear_user(user);
+    event_channel->set_generator(event::gen::disable);
+    event_channel->stop();
+    event_channel = nullptr;
+  }
+
+  // Same as setup_timers() in wiring.c
+  TCB.EVCTRL = 0;
+  TCB.CTRLB = TCB_CNTMODE_PWM8_gc;
+  TCB.CCMPL = PWM_TIMER_PERIOD;
+  TCB.CCMPH = PWM_TIMER_COMPARE;
+  TCB.CTRLA = TCB_CLKSEL_CLKTCA_gc | TCB_ENABLE_bm;
+}
+
+/**
+ * @brief Checks if a new measurement has arrived since the last call.
+ *        The measurement is latched, so period(), pulseWidth() and the other
+ *        getters always refer to the same signal period
+ *
+ * @return true if there's a new measurement
+ */
+bool InputCapture::available()
+{
+  if(!new_capture)
+    return false;
+
+  uint8_t status = SREG;
+  cli();
+  last_period = new_period;
+  last_pulse_width = new_pulse_width;
+  new_capture = false;
+  SREG = status;
+  return true;
+}
+
+/**
+ * @brief Period of the last latched measurement
+ *
+ * @return uint16_t period in timer ticks
+ */
+uint16_t InputCapture::period()
+{
+  return last_period;
+}
+
+/**
+ * @brief Pulse width (high time) of the last latched measurement
+ *
+ * @return uint16_t pulse width in timer ticks
+ */
+uint16_t InputCapture::pulseWidth()
+{
+  return last_pulse_width;
+}
+
+uint32_t InputCapture::periodMicros()
+{
+  return last_period * (1000000.0 / ticksPerSecond());
+}
+
+uint32_t InputCapture::pulseWidthMicros()
+{
+  return last_pulse_width * (1000000.0 / ticksPerSecond());
+}
+
+/**
+ * @brief Frequency of the last latched measurement
+ *
+ * @return float frequency in Hz, or 0 if nothing has been measured yet
+ */
+float InputCapture::frequency()
+{
+  if(last_period == 0)
+    return 0;
+  return (float)ticksPerSecond() / last_period;
+}
+
+/**
+ * @brief Duty cycle of the last latched measurement
+ *
+ * @return float duty cycle in percent
+ */
+float InputCapture::dutyCycle()
+{
+  if(last_period == 0)
+    return 0;
+  return last_pulse_width * 100.0 / last_period;
+}
+
+/**
+ * @brief Timer clock frequency for the selected clock source
+ *
+ * @return uint32_t timer ticks per second
+ */
+uint32_t InputCapture::ticksPerSecond()
+{
+  if(clock == capture::clock::div1)
+    return F_CPU;
+  else if(clock == capture::clock::div2)
+    return F_CPU / 2;
+
+  // TCA0 prescaler is set up in wiring.c, but may have been changed by the user
+  static const uint16_t tca_prescaler[] = {1, 2, 4, 8, 16, 64, 256, 1024};
+  return F_CPU / tca_prescaler[(TCA0.SINGLE.CTRLA & TCA_SINGLE_CLKSEL_gm) >> TCA_SINGLE_CLKSEL_gp];
+}
+
+/**
+ * @brief Calls a function from the timer interrupt every time a new
+ *        measurement is done
+ *
+ * @param userFunc Function taking period and pulse width in timer ticks
+ */
+void InputCapture::attachInterrupt(captureFuncPtr userFunc)
+{
+  uint8_t status = SREG;
+  cli();
+  callback = userFunc;
+  SREG = status;
+}
+
+void InputCapture::detachInterrupt()
+{
+  uint8_t status = SREG;
+  cli();
+  callback = nullptr;
+  SREG = status;
+}
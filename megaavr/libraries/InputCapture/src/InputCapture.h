@@ -0,0 +1,82 @@
+#ifndef INPUTCAPTURE_h
+#define INPUTCAPTURE_h
+
+#include <Arduino.h>
+#include <Event.h>
+
+namespace capture
+{
+  namespace clock
+  {
+    enum clock_t : uint8_t
+    {
+      div1 = 0x00, // F_CPU
+      div2 = 0x02, // F_CPU/2
+      tca0 = 0x04, // Same clock as TCA0, 250kHz with the default core settings
+    };
+  };
+};
+
+typedef void (*captureFuncPtr)(uint16_t period, uint16_t pulse_width);
+
+class InputCapture
+{
+  public:
+    InputCapture(const uint8_t timer_number, TCB_t& tcb, event::user::user_t user);
+    bool begin(uint8_t pin);
+    void end();
+    bool available();
+    uint16_t period();
+    uint16_t pulseWidth();
+    uint32_t periodMicros();
+    uint32_t pulseWidthMicros();
+    float frequency();
+    float dutyCycle();
+    uint32_t ticksPerSecond();
+    void attachInterrupt(captureFuncPtr callback);
+    void detachInterrupt();
+
+    // Called from the TCB interrupt
+    inline void capture_handler()
+    {
+      // The counter holds the period, and stops until CCMP is read
+      uint16_t period = TCB.CNT;
+      uint16_t pulse_width = TCB.CCMP;
+      new_period = period;
+      new_pulse_width = pulse_width;
+      new_capture = true;
+      if(callback)
+        callback(period, pulse_width);
+    }
+
+    capture::clock::clock_t clock = capture::clock::div1;
+    bool filter = false;
+
+  private:
+    const uint8_t timer_number;
+    TCB_t& TCB;
+    const event::user::user_t user;
+    Event *event_channel = nullptr;
+    captureFuncPtr callback = nullptr;
+    volatile uint16_t new_period = 0;
+    volatile uint16_t new_pulse_width = 0;
+    volatile bool new_capture = false;
+    uint16_t last_period = 0;
+    uint16_t last_pulse_width = 0;
+};
+
+// The timer used for millis can't be used for input capture
+#if defined(TCB0) && !defined(MILLIS_USE_TIMERB0)
+extern InputCapture InputCapture0;
+#endif
+#if defined(TCB1) && !defined(MILLIS_USE_TIMERB1)
+extern InputCapture InputCapture1;
+#endif
+#if defined(TCB2) && !defined(MILLIS_USE_TIMERB2)
+extern InputCapture InputCapture2;
+#endif
+#if defined(TCB3) && !defined(MILLIS_USE_TIMERB3)
+extern InputCapture InputCapture3;
+#endif
+
+#endif
@@ -0,0 +1,16 @@
+// Each instance lives in its own file together with its ISR, so only the
+// timers actually used are linked in, thanks to dot_a_linkage set in
+// library.properties. This also keeps the ISR from colliding with other
+// libraries using the same timer, unless the instance is used
+
+#include "InputCapture.h"
+
+#if defined(TCB0) && !defined(MILLIS_USE_TIMERB0)
+InputCapture InputCapture0(0, TCB0, event::user::tcb0_capt);
+TCB_CLAIM(0);
+
+ISR(TCB0_INT_vect)
+{
+  InputCapture0.capture_handler();
+}
+#endif
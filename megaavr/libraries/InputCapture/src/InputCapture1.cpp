@@ -0,0 +1,16 @@
+// Each instance lives in its own file together with its ISR, so only the
+// timers actually used are linked in, thanks to dot_a_linkage set in
+// library.properties. This also keeps the ISR from colliding with other
+// libraries using the same timer, unless the instance is used
+
+#include "InputCapture.h"
+
+#if defined(TCB1) && !defined(MILLIS_USE_TIMERB1)
+InputCapture InputCapture1(1, TCB1, event::user::tcb1_capt);
+TCB_CLAIM(1);
+
+ISR(TCB1_INT_vect)
+{
+  InputCapture1.capture_handler();
+}
+#endif
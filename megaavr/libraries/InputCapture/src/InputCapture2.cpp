@@ -0,0 +1,16 @@
+// Each instance lives in its own file together with its ISR, so only the
+// timers actually used are linked in, thanks to dot_a_linkage set in
+// library.properties. This also keeps the ISR from colliding with other
+// libraries using the same timer, unless the instance is used
+
+#include "InputCapture.h"
+
+#if defined(TCB2) && !defined(MILLIS_USE_TIMERB2)
+InputCapture InputCapture2(2, TCB2, event::user::tcb2_capt);
+TCB_CLAIM(2);
+
+ISR(TCB2_INT_vect)
+{
+  InputCapture2.capture_handler();
+}
+#endif
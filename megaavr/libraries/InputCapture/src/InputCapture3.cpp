@@ -0,0 +1,16 @@
+// Each instance lives in its own file together with its ISR, so only the
+// timers actually used are linked in, thanks to dot_a_linkage set in
+// library.properties. This also keeps the ISR from colliding with other
+// libraries using the same timer, unless the instance is used
+
+#include "InputCapture.h"
+
+#if defined(TCB3) && !defined(MILLIS_USE_TIMERB3)
+InputCapture InputCapture3(3, TCB3, event::user::tcb3_capt);
+TCB_CLAIM(3);
+
+ISR(TCB3_INT_vect)
+{
+  InputCapture3.capture_handler();
+}
+#endif
@@ -0,0 +1,71 @@
+/***********************************************************************|
+| megaAVR PCM library                                                   |
+|                                                                       |
+| SD_streaming.ino                                                      |
+|                                                                       |
+| A library for playing 8-bit samples in the background using TCA0.     |
+| Developed in 2021 by MCUdude                                          |
+| https://github.com/MCUdude/                                           |
+|                                                                       |
+| In this example we stream an audio clip from an SD card to pin PD0.   |
+| The clip is far too large to fit in RAM, so a 512 byte buffer is      |
+| split in two halves. While the timer interrupt plays one half,        |
+| PCM.update() refills the other half from the SD card.                 |
+|                                                                       |
+| The file must contain raw unsigned 8-bit mono samples at 16kHz, with  |
+| no header. A WAV file can be converted using for instance SoX:        |
+| sox input.wav -r 16000 -c 1 -b 8 -e unsigned-integer SOUND.RAW        |
+|                                                                       |
+| Connect a small speaker to PD0 through a 100 ohm resistor, and the    |
+| SD card to the default SPI pins with CS on pin PA7.                   |
+|***********************************************************************/
+
+#include <SD.h>
+#include <PCM.h>
+
+const uint8_t chipSelect = PIN_PA7;
+
+File soundFile;
+uint8_t buffer[512];
+
+// Called from PCM.update() every time half of the buffer has been played
+uint16_t fillBuffer(uint8_t *buf, uint16_t size)
+{
+  int bytes = soundFile.read(buf, size);
+  return bytes > 0 ? bytes : 0;
+}
+
+void setup()
+{
+  Serial.begin(9600);
+
+  if(!SD.begin(chipSelect))
+  {
+    Serial.println("SD card initialization failed");
+    while(true);
+  }
+
+  PCM.begin(PIN_PD0, 16000);
+}
+
+void loop()
+{
+  soundFile = SD.open("SOUND.RAW");
+  if(!soundFile)
+  {
+    Serial.println("Could not open SOUND.RAW");
+    while(true);
+  }
+
+  Serial.println("Playing SOUND.RAW");
+  PCM.stream(buffer, sizeof(buffer), fillBuffer);
+
+  // 256 samples at 16kHz lasts 16ms, which is how often PCM.update() has
+  // to be called for the output to keep up
+  while(PCM.isPlaying())
+    PCM.update();
+
+  soundFile.close();
+  Serial.println("Done");
+  delay(2000);
+}
@@ -0,0 +1,54 @@
+/***********************************************************************|
+| megaAVR PCM library                                                   |
+|                                                                       |
+| Waveform.ino                                                          |
+|                                                                       |
+| A library for playing 8-bit samples in the background using TCA0.     |
+| Developed in 2021 by MCUdude                                          |
+| https://github.com/MCUdude/                                           |
+|                                                                       |
+| In this example we generate waveforms on pin PD0 by looping a table   |
+| of samples. Every sample is written to the TCA0 compare buffer from   |
+| the timer overflow interrupt, so the sample rate is exact and the     |
+| main loop is free to do other things.                                 |
+|                                                                       |
+| A sine table stored in flash is played first, followed by a sawtooth  |
+| generated in RAM. Connect a simple RC low-pass filter (1k and 100nF)  |
+| to the pin to get a smooth waveform, or a small speaker through a     |
+| 100 ohm resistor to hear it.                                          |
+|***********************************************************************/
+
+#include <PCM.h>
+
+// 32 samples at 32kHz gives a 1kHz tone.
+// Const arrays are placed in the memory-mapped flash, and can be played
+// directly without using RAM
+const uint8_t sine[32] = {
+  128, 153, 177, 199, 218, 234, 245, 253, 255, 253, 245, 234, 218, 199, 177, 153,
+  128, 103,  79,  57,  38,  22,  11,   3,   1,   3,  11,  22,  38,  57,  79, 103
+};
+
+uint8_t sawtooth[64];
+
+void setup()
+{
+  // TCA0 is routed to PORTD, and PWM on the other TCA0 pins is not available
+  // until PCM.end() is called
+  PCM.begin(PIN_PD0, 32000);
+
+  for(uint8_t i = 0; i < sizeof(sawtooth); i++)
+    sawtooth[i] = i * 4;
+}
+
+void loop()
+{
+  PCM.play(sine, sizeof(sine), true);
+  delay(1000);
+
+  // 64 samples at 32kHz gives a 500Hz tone
+  PCM.play(sawtooth, sizeof(sawtooth), true);
+  delay(1000);
+
+  PCM.stop();
+  delay(1000);
+}
@@ -0,0 +1,235 @@
+#include "PCM.h"
+
+PCMPlayer PCM;
+
+// The TCA0 overflow vector is owned by the core, which also uses it for
+// pwmUpdateEnd() in split mode
+static void overflow_handler()
+{
+  PCM.sample_handler();
+}
+
+/**
+ * @brief Sets up TCA0 for sample playback on a pin. TCA0 is put in 16-bit
+ *        single mode and clocked directly from F_CPU, with one PWM period per
+ *        sample. The output rests at mid level (silence) until something is
+ *        played
+ *
+ * @param pin Arduino pin connected to TCA0 WO0, WO1 or WO2. That is pin 0, 1
+ *        or 2 on any port. TCA0 is routed to the port of the pin
+ * @param sample_rate Sample rate in Hz, between F_CPU / 65536 and F_CPU / 256
+ * @return true if the pin and sample rate can be used
+ */
+bool PCMPlayer::begin(uint8_t pin, uint16_t sample_rate)
+{
+  uint8_t port = digitalPinToPort(pin);
+  uint8_t channel = digitalPinToBitPosition(pin);
+  if(port == NOT_A_PORT || channel >= 3 || sample_rate == 0)
+    return false;
+
+  // Each sample is scaled from 8 bits to the PWM period, so the period has to
+  // be at least 256 timer ticks
+  uint32_t ticks = F_CPU / sample_rate;
+  if(ticks < 256 || ticks > 65536)
+    return false;
+
+  stop();
+  saved_clksel = TCA0.SINGLE.CTRLA & TCA_SINGLE_CLKSEL_gm;
+  saved_route = PORTMUX.TCAROUTEA;
+
+  pwmSetMode(TCA_SINGLE_MODE);
+  pwmAttachOverflow(overflow_handler);
+  PORTMUX.TCAROUTEA = port;
+  period = ticks;
+  compare_buffer = &TCA0.SINGLE.CMP0BUF + channel;
+
+  TCA0.SINGLE.CTRLA = 0;
+  TCA0.SINGLE.CNT = 0;
+  TCA0.SINGLE.PER = ticks - 1;
+  (&TCA0.SINGLE.CMP0)[channel] = ticks >> 1;
+  TCA0.SINGLE.CTRLB |= (1 << (TCA_SINGLE_CMP0EN_bp + channel));
+  TCA0.SINGLE.CTRLA = TCA_SINGLE_CLKSEL_DIV1_gc | TCA_SINGLE_ENABLE_bm;
+
+  pinMode(pin, OUTPUT);
+  return true;
+}
+
+/**
+ * @brief Stops playback and puts TCA0 back in the state analogWrite() and
+ *        pwmWrite() expects, with the prescaler and routing used before begin()
+ */
+void PCMPlayer::end()
+{
+  stop();
+  pwmAttachOverflow(NULL);
+  pwmSetMode(TCA_SPLIT_MODE);
+  pwmPrescaler(TCA0_0, (timers_prescaler_t)saved_clksel);
+  PORTMUX.TCAROUTEA = saved_route;
+  compare_buffer = nullptr;
+}
+
+/**
+ * @brief Plays unsigned 8-bit samples from RAM, or from const arrays, which
+ *        the compiler places in the memory-mapped flash. Any ongoing playback
+ *        is stopped first
+ *
+ * @param samples Sample buffer
+ * @param length Number of samples
+ * @param loop Start over when the end is reached, useful for waveforms
+ */
+void PCMPlayer::play(const uint8_t *samples, uint16_t length, bool loop)
+{
+  stop();
+  streaming = false;
+  looping = loop;
+  loop_start = samples;
+  start(samples, length);
+}
+
+/**
+ * @brief Same as play(), but for arrays stored with PROGMEM. Flash is read
+ *        through the memory-mapped flash area, so there's no pgm_read
+ *        overhead in the interrupt
+ */
+void PCMPlayer::play_P(const uint8_t *samples, uint16_t length, bool loop)
+{
+  play((const uint8_t *)((uintptr_t)samples + MAPPED_PROGMEM_START), length, loop);
+}
+
+/**
+ * @brief Plays a stream of samples from a double buffer. The buffer is split
+ *        in two halves, and while one half is played, update() refills the
+ *        other one by calling the fill function. This makes it possible to
+ *        play clips that don't fit in memory, for instance from an SD card
+ *
+ * @param buf Buffer used for the samples
+ * @param size Size of buf in bytes. Each refill is half of this
+ * @param fill Function for filling the buffer. It's called from update()
+ * @return true if the fill function returned any samples
+ */
+bool PCMPlayer::stream(uint8_t *buf, uint16_t size, pcmFillFuncPtr fill)
+{
+  stop();
+  buffer = buf;
+  half_size = size / 2;
+  fill_callback = fill;
+  end_of_stream = false;
+  block_full = 0;
+  block_fill = 0;
+  looping = false;
+
+  // Fill both halves before starting
+  streaming = true;
+  update();
+  if(!(block_full & 0x01))
+  {
+    streaming = false;
+    return false;
+  }
+  block_playing = 0;
+  start(buffer, block_length[0]);
+  return true;
+}
+
+/**
+ * @brief Refills the stream buffer. Call this often from loop(). A half
+ *        buffer has to be refilled before the other half has been played,
+ *        or the output pauses until it is
+ */
+void PCMPlayer::update()
+{
+  while(streaming && !end_of_stream && !(block_full & (1 << block_fill)))
+  {
+    // The interrupt never touches a half that isn't marked as full
+    uint16_t length = fill_callback(buffer + block_fill * half_size, half_size);
+    if(length)
+    {
+      block_length[block_fill] = length;
+      uint8_t status = SREG;
+      cli();
+      block_full |= (1 << block_fill);
+      SREG = status;
+    }
+    // Set after the block is marked as full, so the interrupt doesn't stop
+    // before the last block has been played
+    if(length < half_size)
+      end_of_stream = true;
+    block_fill ^= 1;
+  }
+}
+
+/**
+ * @brief Stops playback. The output goes back to mid level
+ */
+void PCMPlayer::stop()
+{
+  uint8_t status = SREG;
+  cli();
+  halt();
+  streaming = false;
+  SREG = status;
+}
+
+bool PCMPlayer::isPlaying()
+{
+  return playing;
+}
+
+void PCMPlayer::start(const uint8_t *samples, uint16_t length)
+{
+  if(!compare_buffer || !length)
+    return;
+
+  uint8_t status = SREG;
+  cli();
+  sample_ptr = samples;
+  sample_end = samples + length;
+  playing = true;
+  TCA0.SINGLE.INTFLAGS = TCA_SINGLE_OVF_bm;
+  TCA0.SINGLE.INTCTRL = TCA_SINGLE_OVF_bm;
+  SREG = status;
+}
+
+// Called with interrupts disabled
+void PCMPlayer::halt()
+{
+  TCA0.SINGLE.INTCTRL = 0;
+  playing = false;
+  if(compare_buffer)
+    *compare_buffer = period >> 1;
+}
+
+// Called from the interrupt when the current block of samples is done.
+// Returns false if there is nothing more to play right now
+bool PCMPlayer::next_block()
+{
+  if(!streaming)
+  {
+    if(looping)
+    {
+      sample_ptr = loop_start;
+      return true;
+    }
+    halt();
+    return false;
+  }
+
+  uint8_t next = block_playing ^ 1;
+  if(block_full & (1 << next))
+  {
+    block_full &= ~(1 << block_playing);
+    block_playing = next;
+    sample_ptr = buffer + next * half_size;
+    sample_end = sample_ptr + block_length[next];
+    return true;
+  }
+
+  if(end_of_stream)
+  {
+    block_full = 0;
+    halt();
+  }
+  // Otherwise update() hasn't refilled the next half yet. Hold the current
+  // output level and try again on the next sample
+  return false;
+}
@@ -0,0 +1,64 @@
+#ifndef PCM_h
+#define PCM_h
+
+#include <Arduino.h>
+
+// Refill function used by stream(). Fills the buffer with up to size samples
+// and returns the number of samples written. Returning less than size ends
+// the stream once the samples have been played
+typedef uint16_t (*pcmFillFuncPtr)(uint8_t *buffer, uint16_t size);
+
+class PCMPlayer
+{
+  public:
+    bool begin(uint8_t pin, uint16_t sample_rate);
+    void end();
+    void play(const uint8_t *samples, uint16_t length, bool loop = false);
+    void play_P(const uint8_t *samples, uint16_t length, bool loop = false);
+    bool stream(uint8_t *buffer, uint16_t size, pcmFillFuncPtr fill);
+    void update();
+    void stop();
+    bool isPlaying();
+
+    // Called from the TCA0 overflow interrupt
+    inline void sample_handler()
+    {
+      if(sample_ptr == sample_end && !next_block())
+        return;
+      // The buffer register is copied to the compare register at the next
+      // overflow, so every sample lasts exactly one PWM period
+      *compare_buffer = ((uint32_t)*sample_ptr++ * period) >> 8;
+    }
+
+  private:
+    bool next_block();
+    void halt();
+    void start(const uint8_t *samples, uint16_t length);
+
+    volatile uint16_t *compare_buffer = nullptr;
+    uint16_t period = 0;
+    uint8_t saved_clksel = 0;
+    uint8_t saved_route = 0;
+
+    const uint8_t *sample_ptr = nullptr;
+    const uint8_t *sample_end = nullptr;
+    const uint8_t *loop_start = nullptr;
+    volatile bool playing = false;
+    bool looping = false;
+
+    // Double buffer used by stream(). The interrupt plays one half while
+    // update() refills the other one
+    volatile bool streaming = false;
+    uint8_t *buffer = nullptr;
+    uint16_t half_size = 0;
+    uint16_t block_length[2];
+    volatile uint8_t block_full = 0;
+    uint8_t block_playing = 0;
+    uint8_t block_fill = 0;
+    volatile bool end_of_stream = false;
+    pcmFillFuncPtr fill_callback = nullptr;
+};
+
+extern PCMPlayer PCM;
+
+#endif
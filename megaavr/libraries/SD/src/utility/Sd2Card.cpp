@@ -447,6 +447,16 @@ uint8_t Sd2Card::readData(uint32_t block,
     ;
   dst[n] = SPDR;
 
+  #elif defined(SPI_HAS_TRANSFER_TX_RX)
+
+  // skip data before offset
+  if (offset > offset_) {
+    SDCARD_SPI.transfer(NULL, NULL, offset - offset_);
+    offset_ = offset;
+  }
+  // transfer data straight into the destination
+  SDCARD_SPI.transfer(NULL, dst, count);
+
   #else  // OPTIMIZE_HARDWARE_SPI
 
   // skip data before offset
@@ -684,6 +694,9 @@ uint8_t Sd2Card::writeData(uint8_t token, const uint8_t* src) {
   while (!(SPSR & (1 << SPIF)))
     ;
 
+  #elif defined(SPI_HAS_TRANSFER_TX_RX)
+  spiSend(token);
+  SDCARD_SPI.transfer(src, NULL, 512);
   #else  // OPTIMIZE_HARDWARE_SPI
   spiSend(token);
   for (uint16_t i = 0; i < 512; i++) {
@@ -0,0 +1,62 @@
+/*
+  Async Transfer
+
+  This example sends a frame buffer to an SPI display in the background while
+  the main loop keeps doing other work. The frame is split into lines that
+  are queued with SPI.transferAsync(). Each transfer pulls the chip select pin
+  low while it runs, and a callback counts the lines as they are sent.
+
+  transferAsync() returns false when the queue is full, so the sketch simply
+  tries again later. SPI.waitAsync() blocks until everything queued has been
+  sent, and beginTransaction() does the same before changing any settings.
+
+  The circuit:
+  * CS - to digital pin 10
+  * MOSI - to the display data input
+  * SCK - to the display clock input
+
+  This example code is in the public domain.
+*/
+
+#include <SPI.h>
+
+const uint8_t displayCsPin = 10;
+const uint8_t lineLength = 64;
+const uint8_t lineCount = 32;
+
+uint8_t frame[lineCount][lineLength];
+volatile uint8_t linesSent = 0;
+uint8_t nextLine = 0;
+
+void lineSent() {
+  linesSent++;
+}
+
+void setup() {
+  Serial1.begin(9600);
+  pinMode(displayCsPin, OUTPUT);
+  digitalWrite(displayCsPin, HIGH);
+  SPI.begin();
+  SPI.beginTransaction(SPISettings(8000000, MSBFIRST, SPI_MODE0));
+}
+
+void loop() {
+  // Queue as many lines as there is room for. Received data is discarded
+  if (nextLine < lineCount) {
+    if (SPI.transferAsync(frame[nextLine], NULL, lineLength, displayCsPin, lineSent))
+      nextLine++;
+  } else if (linesSent == lineCount) {
+    // The frame is done, draw the next one
+    frame[0][0]++;
+    nextLine = 0;
+    linesSent = 0;
+  }
+
+  // Meanwhile, do something else
+  static uint32_t lastPrint = 0;
+  if (millis() - lastPrint >= 1000) {
+    lastPrint = millis();
+    Serial1.print("Lines sent: ");
+    Serial1.println(linesSent);
+  }
+}
@@ -0,0 +1,64 @@
+/*
+  Slave Frames
+
+  This example turns the microcontroller into an SPI slave, for instance a
+  co-processor behind a Linux board. The master sends frames framed by the
+  slave select pin. Every byte is read into a ring buffer by the SPI
+  interrupt, and the onFrame() callback is called when SS goes high with the
+  number of bytes in the frame.
+
+  The reply to a frame is written to the transmit ring with SPISlave.write()
+  and is clocked out during the next frame. Preload it before the master
+  starts the next frame, since what the master reads when the ring is empty
+  is undefined.
+
+  MISO is driven all the time while the slave is enabled, so add a resistor
+  or a buffer if other slaves share the bus.
+
+  The circuit:
+  * SS, MOSI, SCK and MISO - to the master's SPI pins
+
+  This example code is in the public domain.
+*/
+
+#include <SPISlave.h>
+
+volatile uint16_t lastFrameLength = 0;
+
+void frameReceived(uint16_t length) {
+  lastFrameLength = length;
+}
+
+void setup() {
+  Serial1.begin(115200);
+  SPISlave.onFrame(frameReceived);
+  SPISlave.begin(SPI_MODE0);
+
+  // Reply to the first frame with a greeting
+  SPISlave.print("Hello");
+}
+
+void loop() {
+  uint16_t length = lastFrameLength;
+  if (length == 0)
+    return;
+  lastFrameLength = 0;
+
+  Serial1.print("Frame of ");
+  Serial1.print(length);
+  Serial1.print(" bytes:");
+
+  // Answer with the sum of the bytes received
+  uint8_t sum = 0;
+  while (SPISlave.available()) {
+    uint8_t data = SPISlave.read();
+    sum += data;
+    Serial1.print(' ');
+    Serial1.print(data, HEX);
+  }
+  Serial1.println();
+  SPISlave.write(sum);
+
+  if (SPISlave.overflows())
+    Serial1.println("Receive buffer overflow!");
+}
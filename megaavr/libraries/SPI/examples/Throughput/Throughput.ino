@@ -0,0 +1,72 @@
+/*
+  Throughput
+
+  This example measures how fast the SPI block transfer functions run at the
+  highest clock speed, SPI_CLOCK_DIV2 (F_CPU / 2). No device has to be
+  connected, the data is simply clocked out on MOSI and whatever is on MISO
+  is read back.
+
+  SPI.transfer(buf, count) sends and receives in place, SPI.writeBytes()
+  only sends and SPI.readBytes() only receives while sending 0xFF. All of
+  them use the buffered mode of the SPI peripheral, so the next byte is
+  ready before the current one has been shifted out. The single byte
+  SPI.transfer(data) is included for comparison.
+
+  The results are printed to Serial1 in kilobytes per second.
+
+  This example code is in the public domain.
+*/
+
+#include <SPI.h>
+
+const uint16_t blockSize = 512;
+const uint8_t repeats = 20;
+
+uint8_t buffer[blockSize];
+
+void printResult(const char *name, uint32_t elapsed) {
+  uint32_t bytes = (uint32_t)blockSize * repeats;
+  Serial1.print(name);
+  Serial1.print(": ");
+  Serial1.print(bytes * 1000UL / elapsed);
+  Serial1.println(" kB/s");
+}
+
+void setup() {
+  Serial1.begin(115200);
+  SPI.begin();
+  SPI.beginTransaction(SPISettings(F_CPU / 2, MSBFIRST, SPI_MODE0));
+}
+
+void loop() {
+  uint32_t start;
+
+  Serial1.print("SPI clock: ");
+  Serial1.print(F_CPU / 2000UL);
+  Serial1.println(" kHz");
+
+  start = micros();
+  for (uint8_t i = 0; i < repeats; i++) {
+    for (uint16_t j = 0; j < blockSize; j++)
+      buffer[j] = SPI.transfer(buffer[j]);
+  }
+  printResult("transfer(data)          ", micros() - start);
+
+  start = micros();
+  for (uint8_t i = 0; i < repeats; i++)
+    SPI.transfer(buffer, blockSize);
+  printResult("transfer(buf, count)    ", micros() - start);
+
+  start = micros();
+  for (uint8_t i = 0; i < repeats; i++)
+    SPI.writeBytes(buffer, blockSize);
+  printResult("writeBytes(buf, count)  ", micros() - start);
+
+  start = micros();
+  for (uint8_t i = 0; i < repeats; i++)
+    SPI.readBytes(buffer, blockSize);
+  printResult("readBytes(buf, count)   ", micros() - start);
+
+  Serial1.println();
+  delay(2000);
+}
@@ -29,6 +29,8 @@ const SPISettings DEFAULT_SPI_SETTINGS = SPISettings();
 SPIClass::SPIClass()
 {
   initialized = false;
+  asyncHead = 0;
+  asyncCount = 0;
 
   // Default mux setting
  #if defined(SPI_MUX)
@@ -145,6 +147,7 @@ void SPIClass::config(SPISettings settings)
 
 void SPIClass::end()
 {
+  waitAsync();
   SPI0.CTRLA &= ~(SPI_ENABLE_bm);
   initialized = false;
 }
@@ -246,6 +249,9 @@ void SPIClass::reattachMaskedInterrupts() {
 
 void SPIClass::beginTransaction(SPISettings settings)
 {
+  // Let queued asynchronous transfers finish with their own settings
+  waitAsync();
+
   if (interruptMode != SPI_IMODE_NONE)
   {
     if (interruptMode & SPI_IMODE_GLOBAL)
@@ -295,6 +301,9 @@ void SPIClass::setClockDivider(uint8_t div)
 
 byte SPIClass::transfer(uint8_t data)
 {
+  // Let queued async transfers finish before touching the data register
+  waitAsync();
+
   /*
   * The following NOP introduces a small delay that can prevent the wait
   * loop from iterating when running at the maximum speed. This gives
@@ -324,13 +333,124 @@ uint16_t SPIClass::transfer16(uint16_t data) {
   return t.val;
 }
 
+/*
+ * The block transfers below use buffered mode. The next byte is written to
+ * the transmit buffer while the previous one is still being shifted out,
+ * so SCK keeps running between bytes instead of stopping while the received
+ * byte is read back.
+ */
 void SPIClass::transfer(void *buf, size_t count)
 {
-  uint8_t *buffer = reinterpret_cast<uint8_t *>(buf);
-  for (size_t i=0; i<count; i++) {
-    *buffer = transfer(*buffer);
-    buffer++;
+  // Each byte is sent before the one before it is stored, so the same
+  // buffer can be used for both directions
+  transfer(buf, buf, count);
+}
+
+/*
+ * Full duplex transfer with separate buffers. txBuf may be NULL to send 0xFF,
+ * and rxBuf may be NULL to throw away what's received. Those cases are
+ * handed to readBytes() and writeBytes(), which don't touch the unused buffer.
+ */
+void SPIClass::transfer(const void *txBuf, void *rxBuf, size_t count)
+{
+  waitAsync();
+
+  if (rxBuf == NULL)
+  {
+    writeBytes(txBuf, count);
+    return;
   }
+  if (txBuf == NULL)
+  {
+    readBytes(rxBuf, count);
+    return;
+  }
+  if (count == 0)
+    return;
+
+  const uint8_t *tx = reinterpret_cast<const uint8_t *>(txBuf);
+  uint8_t *rx = reinterpret_cast<uint8_t *>(rxBuf);
+  uint8_t ctrlb = SPI0.CTRLB;
+  SPI0.CTRLB = ctrlb | SPI_BUFEN_bm | SPI_BUFWR_bm;
+
+  // The first byte goes straight to the shift register
+  SPI0.DATA = *tx++;
+  while (--count)
+  {
+    while ((SPI0.INTFLAGS & SPI_DREIF_bm) == 0);
+    SPI0.DATA = *tx++;
+    while ((SPI0.INTFLAGS & SPI_RXCIF_bm) == 0);
+    *rx++ = SPI0.DATA;
+  }
+  while ((SPI0.INTFLAGS & SPI_RXCIF_bm) == 0);
+  *rx = SPI0.DATA;
+
+  SPI0.CTRLB = ctrlb;
+}
+
+void SPIClass::writeBytes(const void *buf, size_t count)
+{
+  // TXCIF would never be set without a byte to send
+  if (count == 0)
+    return;
+  waitAsync();
+
+  const uint8_t *txBuf = reinterpret_cast<const uint8_t *>(buf);
+  uint8_t ctrlb = SPI0.CTRLB;
+  SPI0.CTRLB = ctrlb | SPI_BUFEN_bm | SPI_BUFWR_bm;
+  SPI0.INTFLAGS = SPI_TXCIF_bm;
+
+  // Nothing is read back, so only the transmit buffer has to be kept full.
+  // Without a buffer, 0xFF is sent
+  if (txBuf)
+  {
+    while (count--)
+    {
+      while ((SPI0.INTFLAGS & SPI_DREIF_bm) == 0);
+      SPI0.DATA = *txBuf++;
+    }
+  }
+  else
+  {
+    while (count--)
+    {
+      while ((SPI0.INTFLAGS & SPI_DREIF_bm) == 0);
+      SPI0.DATA = 0xFF;
+    }
+  }
+
+  // Wait for the last byte to be shifted out, then throw away what was received
+  while ((SPI0.INTFLAGS & SPI_TXCIF_bm) == 0);
+  while (SPI0.INTFLAGS & SPI_RXCIF_bm)
+    (void)SPI0.DATA;
+  SPI0.INTFLAGS = SPI_TXCIF_bm | SPI_BUFOVF_bm;
+
+  SPI0.CTRLB = ctrlb;
+}
+
+void SPIClass::readBytes(void *buf, size_t count, uint8_t fill)
+{
+  if (count == 0)
+    return;
+  waitAsync();
+
+  uint8_t *rxBuf = reinterpret_cast<uint8_t *>(buf);
+  uint8_t ctrlb = SPI0.CTRLB;
+  SPI0.CTRLB = ctrlb | SPI_BUFEN_bm | SPI_BUFWR_bm;
+
+  // Same as transfer(), but with a constant byte to send
+  SPI0.DATA = fill;
+  while (--count)
+  {
+    while ((SPI0.INTFLAGS & SPI_DREIF_bm) == 0);
+    SPI0.DATA = fill;
+    while ((SPI0.INTFLAGS & SPI_RXCIF_bm) == 0);
+    *rxBuf++ = SPI0.DATA;
+  }
+  while ((SPI0.INTFLAGS & SPI_RXCIF_bm) == 0);
+  *rxBuf = SPI0.DATA;
+
+  SPI0.CTRLB = ctrlb;
 }
 
 #if SPI_INTERFACES_COUNT > 0
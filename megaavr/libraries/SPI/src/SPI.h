@@ -26,6 +26,11 @@
 #define USE_MALLOC_FOR_IRQ_MAP  0
 #endif
 
+// Number of transfers that can be queued with transferAsync()
+#ifndef SPI_ASYNC_QUEUE_SIZE
+#define SPI_ASYNC_QUEUE_SIZE    4
+#endif
+
 // SPI_HAS_TRANSACTION means SPI has
 //   - beginTransaction()
 //   - endTransaction()
@@ -36,6 +41,9 @@
 // SPI_HAS_NOTUSINGINTERRUPT means that SPI has notUsingInterrupt() method
 #define SPI_HAS_NOTUSINGINTERRUPT 1
 
+// SPI_HAS_TRANSFER_TX_RX means that SPI has transfer(txBuf, rxBuf, count)
+#define SPI_HAS_TRANSFER_TX_RX 1
+
 #define SPI_MODE0           ( SPI_MODE_0_gc )
 #define SPI_MODE1           ( SPI_MODE_1_gc )
 #define SPI_MODE2           ( SPI_MODE_2_gc )
@@ -142,6 +150,19 @@ class SPISettings {
   friend class SPIClass;
 };
 
+// A transfer queued with transferAsync(). The buffer pointers are advanced
+// by the interrupt as the transfer goes on
+struct SPIAsyncJob {
+  const uint8_t *txBuf;
+  uint8_t *rxBuf;
+  size_t count;
+  PORT_t *csPort;
+  uint8_t csMask;
+  uint8_t ctrla;
+  uint8_t ctrlb;
+  void (*callback)(void);
+};
+
 class SPIClass {
   public:
   SPIClass();
@@ -149,6 +170,21 @@ class SPIClass {
   byte transfer(uint8_t data);
   uint16_t transfer16(uint16_t data);
   void transfer(void *buf, size_t count);
+  void transfer(const void *txBuf, void *rxBuf, size_t count);
+  void writeBytes(const void *buf, size_t count);
+  void readBytes(void *buf, size_t count, uint8_t fill = 0xFF);
+
+  // Asynchronous transfers, run from the SPI interrupt in buffered mode.
+  // txBuf may be NULL to send 0xFF, and rxBuf may be NULL to discard the
+  // received data. pinCS is pulled low for the duration of the transfer,
+  // and the callback is called from the interrupt when it's done
+  bool transferAsync(const void *txBuf, void *rxBuf, size_t count, uint8_t pinCS = NOT_A_PIN, void (*callback)(void) = NULL);
+  uint8_t asyncPending();
+  inline void waitAsync() { while (asyncCount); }
+  void handleInterrupt();  // Called from the SPI interrupt
+
+  // Set by SPISlave, which shares the SPI interrupt with the async transfers
+  static void (*slaveInterrupt)(void);
 
   // Transaction Functions
   void usingInterrupt(int interruptNumber);
@@ -179,6 +215,15 @@ class SPIClass {
   void detachMaskedInterrupts();
   void reattachMaskedInterrupts();
 
+  void startAsyncJob();
+  void fillAsyncJob();
+
+  SPIAsyncJob asyncQueue[SPI_ASYNC_QUEUE_SIZE];
+  volatile uint8_t asyncHead;    // Job being transferred
+  volatile uint8_t asyncCount;   // Jobs queued, including the one being transferred
+  size_t asyncTxLeft;
+  size_t asyncRxLeft;
+
   uint8_t _uc_pinMiso;
   uint8_t _uc_pinMosi;
   uint8_t _uc_pinSCK;
@@ -0,0 +1,144 @@
+/*
+ * Asynchronous SPI master transfers for MegaCoreX.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+// Kept apart from SPI.cpp, so the SPI interrupt vector is only claimed by
+// sketches that queue asynchronous transfers or use SPISlave
+
+#include "SPI.h"
+#include <Arduino.h>
+
+void (*SPIClass::slaveInterrupt)(void);
+
+bool SPIClass::transferAsync(const void *txBuf, void *rxBuf, size_t count, uint8_t pinCS, void (*callback)(void))
+{
+  if (count == 0)
+    return false;
+
+  uint8_t status = SREG;
+  cli();
+  if (asyncCount >= SPI_ASYNC_QUEUE_SIZE)
+  {
+    SREG = status;
+    return false;
+  }
+
+  uint8_t index = (asyncHead + asyncCount) % SPI_ASYNC_QUEUE_SIZE;
+  SPIAsyncJob &job = asyncQueue[index];
+  job.txBuf = reinterpret_cast<const uint8_t *>(txBuf);
+  job.rxBuf = reinterpret_cast<uint8_t *>(rxBuf);
+  job.count = count;
+  job.csPort = (pinCS == NOT_A_PIN) ? NULL : digitalPinToPortStruct(pinCS);
+  job.csMask = (pinCS == NOT_A_PIN) ? 0 : digitalPinToBitMask(pinCS);
+  job.callback = callback;
+
+  // Use the settings of the current transaction, which are only in the
+  // hardware registers while no other transfer is queued
+  if (asyncCount == 0)
+  {
+    job.ctrla = SPI0.CTRLA;
+    job.ctrlb = SPI0.CTRLB;
+  }
+  else
+  {
+    uint8_t last = (index + SPI_ASYNC_QUEUE_SIZE - 1) % SPI_ASYNC_QUEUE_SIZE;
+    job.ctrla = asyncQueue[last].ctrla;
+    job.ctrlb = asyncQueue[last].ctrlb;
+  }
+
+  if (asyncCount++ == 0)
+    startAsyncJob();
+  SREG = status;
+  return true;
+}
+
+uint8_t SPIClass::asyncPending()
+{
+  return asyncCount;
+}
+
+void SPIClass::startAsyncJob()
+{
+  SPIAsyncJob &job = asyncQueue[asyncHead];
+
+  SPI0.CTRLA = job.ctrla;
+  SPI0.CTRLB = job.ctrlb | SPI_BUFEN_bm | SPI_BUFWR_bm;
+  if (job.csPort)
+    job.csPort->OUTCLR = job.csMask;
+
+  asyncTxLeft = job.count;
+  asyncRxLeft = job.count;
+  fillAsyncJob();
+  SPI0.INTCTRL = SPI_RXCIE_bm;
+}
+
+void SPIClass::fillAsyncJob()
+{
+  SPIAsyncJob &job = asyncQueue[asyncHead];
+
+  // Keep at most two bytes in flight, one in the shift register and one in
+  // the transmit buffer. That keeps SCK running without gaps while the
+  // two byte receive buffer can never overflow
+  while (asyncTxLeft && (asyncRxLeft - asyncTxLeft) < 2 && (SPI0.INTFLAGS & SPI_DREIF_bm))
+  {
+    SPI0.DATA = job.txBuf ? *job.txBuf++ : 0xFF;
+    asyncTxLeft--;
+  }
+}
+
+void SPIClass::handleInterrupt()
+{
+  SPIAsyncJob &job = asyncQueue[asyncHead];
+
+  while (SPI0.INTFLAGS & SPI_RXCIF_bm)
+  {
+    uint8_t data = SPI0.DATA;
+    if (job.rxBuf)
+      *job.rxBuf++ = data;
+    asyncRxLeft--;
+  }
+
+  if (asyncRxLeft)
+  {
+    fillAsyncJob();
+    return;
+  }
+
+  // The last byte has been clocked out, so the transfer is done
+  if (job.csPort)
+    job.csPort->OUTSET = job.csMask;
+  void (*callback)(void) = job.callback;
+  uint8_t ctrlb = job.ctrlb;
+
+  asyncHead = (asyncHead + 1) % SPI_ASYNC_QUEUE_SIZE;
+  if (--asyncCount)
+    startAsyncJob();
+  else
+  {
+    SPI0.INTCTRL = 0;
+    SPI0.CTRLB = ctrlb;
+  }
+
+  if (callback)
+    callback();
+}
+
+#if SPI_INTERFACES_COUNT > 0
+  ISR(SPI0_INT_vect)
+  {
+    if (SPI0.CTRLA & SPI_MASTER_bm)
+      SPI.handleInterrupt();
+    else if (SPIClass::slaveInterrupt)
+      SPIClass::slaveInterrupt();
+  }
+#endif
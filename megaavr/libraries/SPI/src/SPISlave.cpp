@@ -0,0 +1,224 @@
+/*
+ * SPI Slave library for MegaCoreX.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#include "SPISlave.h"
+#include <Arduino.h>
+
+SPISlaveClass::SPISlaveClass()
+{
+  frameCallback = NULL;
+  frameLength = 0;
+  rxOverflows = 0;
+  rxHead = rxTail = 0;
+  txHead = txTail = 0;
+
+ #if defined(SPI_MUX)
+   _uc_mux = SPI_MUX;
+   _uc_pinSS = PIN_SPI_SS;
+ #endif
+}
+
+bool SPISlaveClass::swap(uint8_t state)
+{
+  if(state == 0)
+  {
+    _uc_mux = SPI_MUX;
+    _uc_pinSS = PIN_SPI_SS;
+    return true;
+  }
+  #if defined(SPI_MUX_PINSWAP_1)
+  else if(state == 1)
+    {
+      _uc_mux = SPI_MUX_PINSWAP_1;
+      _uc_pinSS = PIN_SPI_SS_PINSWAP_1;
+      return true;
+    }
+  #endif
+  #if defined(SPI_MUX_PINSWAP_2)
+    else if(state == 2)
+    {
+      _uc_mux = SPI_MUX_PINSWAP_2;
+      _uc_pinSS = PIN_SPI_SS_PINSWAP_2;
+      return true;
+    }
+  #endif
+  else
+    return false;
+}
+
+static void slaveSelectHandler()
+{
+  SPISlave.handleSlaveSelect();
+}
+
+static void slaveInterruptHandler()
+{
+  SPISlave.handleInterrupt();
+}
+
+void SPISlaveClass::begin(uint8_t dataMode, uint8_t bitOrder)
+{
+  PORTMUX.TWISPIROUTEA = _uc_mux | (PORTMUX.TWISPIROUTEA & ~3);
+
+  // MOSI, SCK and SS are set to input by the controller
+  if(_uc_mux == SPI_MUX)
+    pinMode(PIN_SPI_MISO, OUTPUT);
+  #if defined(SPI_MUX_PINSWAP_1)
+    else if(_uc_mux == SPI_MUX_PINSWAP_1)
+      pinMode(PIN_SPI_MISO_PINSWAP_1, OUTPUT);
+  #endif
+  #if defined(SPI_MUX_PINSWAP_2)
+    else if(_uc_mux == SPI_MUX_PINSWAP_2)
+      pinMode(PIN_SPI_MISO_PINSWAP_2, OUTPUT);
+  #endif
+
+  rxHead = rxTail = 0;
+  txHead = txTail = 0;
+  frameLength = 0;
+  rxOverflows = 0;
+
+  // Buffered mode gives two bytes of receive buffer on top of the shift
+  // register, and lets the first byte of the transmit ring be preloaded
+  SPI0.CTRLA = 0;
+  SPI0.CTRLB = dataMode | SPI_BUFEN_bm | SPI_BUFWR_bm;
+  SPIClass::slaveInterrupt = slaveInterruptHandler;
+  SPI0.INTCTRL = SPI_RXCIE_bm;
+  SPI0.CTRLA = SPI_ENABLE_bm | ((bitOrder == LSBFIRST) << SPI_DORD_bp);
+
+  // The end of a frame is found from the rising edge of SS
+  attachInterrupt(_uc_pinSS, slaveSelectHandler, RISING);
+}
+
+void SPISlaveClass::end()
+{
+  detachInterrupt(_uc_pinSS);
+  SPI0.INTCTRL = 0;
+  SPI0.CTRLA &= ~(SPI_ENABLE_bm);
+}
+
+void SPISlaveClass::onFrame(void (*callback)(uint16_t length))
+{
+  frameCallback = callback;
+}
+
+uint8_t SPISlaveClass::overflows()
+{
+  return rxOverflows;
+}
+
+int SPISlaveClass::available(void)
+{
+  return ((unsigned int)(SPI_SLAVE_RX_BUFFER_SIZE + rxHead - rxTail)) % SPI_SLAVE_RX_BUFFER_SIZE;
+}
+
+int SPISlaveClass::peek(void)
+{
+  if (rxHead == rxTail)
+    return -1;
+  return rxBuffer[rxTail];
+}
+
+int SPISlaveClass::read(void)
+{
+  if (rxHead == rxTail)
+    return -1;
+  uint8_t data = rxBuffer[rxTail];
+  rxTail = (uint8_t)(rxTail + 1) % SPI_SLAVE_RX_BUFFER_SIZE;
+  return data;
+}
+
+int SPISlaveClass::availableForWrite(void)
+{
+  uint8_t head = txHead;
+  uint8_t tail = txTail;
+  if (head >= tail)
+    return SPI_SLAVE_TX_BUFFER_SIZE - 1 - head + tail;
+  return tail - head - 1;
+}
+
+void SPISlaveClass::flush(void)
+{
+  // Wait for the master to clock out everything that has been written
+  while (txHead != txTail);
+}
+
+size_t SPISlaveClass::write(uint8_t data)
+{
+  uint8_t head = (uint8_t)(txHead + 1) % SPI_SLAVE_TX_BUFFER_SIZE;
+  if (head == txTail)
+    return 0;
+
+  txBuffer[txHead] = data;
+  txHead = head;
+
+  // Let the data register empty interrupt feed the hardware
+  uint8_t status = SREG;
+  cli();
+  SPI0.INTCTRL |= SPI_DREIE_bm;
+  SREG = status;
+  return 1;
+}
+
+size_t SPISlaveClass::write(const uint8_t *buffer, size_t size)
+{
+  size_t written = 0;
+  while (written < size && write(buffer[written]))
+    written++;
+  return written;
+}
+
+void SPISlaveClass::handleInterrupt()
+{
+  // Empty the receive buffer, the master doesn't wait for us
+  while (SPI0.INTFLAGS & SPI_RXCIF_bm)
+  {
+    uint8_t data = SPI0.DATA;
+    uint8_t head = (uint8_t)(rxHead + 1) % SPI_SLAVE_RX_BUFFER_SIZE;
+    if (head != rxTail)
+    {
+      rxBuffer[rxHead] = data;
+      rxHead = head;
+    }
+    else if (rxOverflows < 255)
+      rxOverflows++;
+    frameLength++;
+  }
+
+  // Keep the transmit buffer filled from the ring, and stop asking for data
+  // once it's empty. What the master reads after that is undefined
+  while (SPI0.INTFLAGS & SPI_DREIF_bm)
+  {
+    if (txHead == txTail)
+    {
+      SPI0.INTCTRL &= ~(SPI_DREIE_bm);
+      break;
+    }
+    SPI0.DATA = txBuffer[txTail];
+    txTail = (uint8_t)(txTail + 1) % SPI_SLAVE_TX_BUFFER_SIZE;
+  }
+}
+
+void SPISlaveClass::handleSlaveSelect()
+{
+  // Pick up the last byte of the frame before reporting it
+  handleInterrupt();
+  uint16_t length = frameLength;
+  frameLength = 0;
+  if (frameCallback && length)
+    frameCallback(length);
+}
+
+#if SPI_INTERFACES_COUNT > 0
+  SPISlaveClass SPISlave;
+#endif
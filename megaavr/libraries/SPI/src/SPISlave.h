@@ -0,0 +1,82 @@
+/*
+ * SPI Slave library for MegaCoreX.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#ifndef _SPI_SLAVE_H_INCLUDED
+#define _SPI_SLAVE_H_INCLUDED
+
+#include <Arduino.h>
+#include "SPI.h"
+
+// Ring buffer sizes. Both can be overridden, but must not exceed 256 bytes
+#if !defined(SPI_SLAVE_RX_BUFFER_SIZE)
+#if ((RAMEND - RAMSTART) < 1023)
+#define SPI_SLAVE_RX_BUFFER_SIZE 16
+#else
+#define SPI_SLAVE_RX_BUFFER_SIZE 64
+#endif
+#endif
+#if !defined(SPI_SLAVE_TX_BUFFER_SIZE)
+#if ((RAMEND - RAMSTART) < 1023)
+#define SPI_SLAVE_TX_BUFFER_SIZE 16
+#else
+#define SPI_SLAVE_TX_BUFFER_SIZE 64
+#endif
+#endif
+
+class SPISlaveClass : public Stream {
+  public:
+  SPISlaveClass();
+
+  bool swap(uint8_t state = 1);
+  void begin(uint8_t dataMode = SPI_MODE0, uint8_t bitOrder = MSBFIRST);
+  void end();
+
+  // Called from the SS pin interrupt when the master ends a frame, with the
+  // number of bytes clocked in during the frame
+  void onFrame(void (*callback)(uint16_t length));
+  uint8_t overflows();
+
+  virtual int available(void);
+  virtual int peek(void);
+  virtual int read(void);
+  virtual int availableForWrite(void);
+  virtual void flush(void);
+  virtual size_t write(uint8_t data);
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  using Print::write;
+
+  void handleInterrupt();       // Called from the SPI interrupt
+  void handleSlaveSelect();     // Called from the SS pin interrupt
+
+  private:
+  uint8_t _uc_mux;
+  uint8_t _uc_pinSS;
+
+  void (*frameCallback)(uint16_t length);
+  volatile uint16_t frameLength;
+  volatile uint8_t rxOverflows;
+
+  volatile uint8_t rxHead;
+  volatile uint8_t rxTail;
+  volatile uint8_t txHead;
+  volatile uint8_t txTail;
+  uint8_t rxBuffer[SPI_SLAVE_RX_BUFFER_SIZE];
+  uint8_t txBuffer[SPI_SLAVE_TX_BUFFER_SIZE];
+};
+
+#if SPI_INTERFACES_COUNT > 0
+  extern SPISlaveClass SPISlave;
+#endif
+
+#endif
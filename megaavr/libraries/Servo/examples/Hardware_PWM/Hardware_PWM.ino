@@ -0,0 +1,36 @@
+/* Hardware PWM
+
+ Drives two servos from the TCA0 compare outputs instead of the timer
+ interrupt. The pulses are generated entirely in hardware, so they are not
+ affected by other interrupts and cost no CPU time.
+
+ attachPWM() works on pin 0, 1 and 2 of any port, but all servos attached
+ this way must be on the same port. Other pins fall back to the timer
+ interrupt, just like attach(). PWM on the TCA0 pins is not available for
+ analogWrite() while servos are attached with attachPWM().
+
+ This example code is in the public domain.
+*/
+
+#include <Servo.h>
+
+Servo servo1;
+Servo servo2;
+
+void setup() {
+  servo1.attachPWM(PIN_PD0);
+  servo2.attachPWM(PIN_PD1);
+}
+
+void loop() {
+  for (int pos = 0; pos <= 180; pos += 1) {
+    servo1.write(pos);
+    servo2.write(180 - pos);
+    delay(15);
+  }
+  for (int pos = 180; pos >= 0; pos -= 1) {
+    servo1.write(pos);
+    servo2.write(180 - pos);
+    delay(15);
+  }
+}
@@ -0,0 +1,34 @@
+/* Smooth Motion
+
+ Moves a servo back and forth with a limited speed and a smooth start and
+ stop. The movement is handled by the timer interrupt once every refresh
+ interval, so loop() only has to pick a new target when the servo has
+ arrived.
+
+ setSpeed() takes degrees per second and setAcceleration() degrees per second
+ squared. An acceleration of 0 makes the servo move at full speed right away,
+ and a speed of 0 makes moveTo() behave just like write().
+
+ This example code is in the public domain.
+*/
+
+#include <Servo.h>
+
+Servo myservo;
+
+void setup() {
+  myservo.attach(9);
+  myservo.write(0);
+  myservo.setSpeed(90);
+  myservo.setAcceleration(180);
+}
+
+void loop() {
+  myservo.moveTo(180);
+  while (myservo.isMoving());
+  delay(500);
+
+  myservo.moveTo(0);
+  while (myservo.isMoving());
+  delay(500);
+}
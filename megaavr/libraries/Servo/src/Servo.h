@@ -25,8 +25,8 @@
 
   Note that analogWrite of PWM on pins associated with the timer are
   disabled when the first servo is attached.
-  Timers are seized as needed in groups of 12 servos - 24 servos use two
-  timers, 48 servos will use four.
+  All servos on a timer start their pulse at the same time, so one timer can
+  control 24 servos (12 on parts with 1kB RAM) at the normal refresh interval.
   The sequence used to sieze timers is defined in timers.h
 
   The methods are:
@@ -36,6 +36,8 @@
     attach(pin )  - Attaches a servo motor to an i/o pin.
     attach(pin, min, max  ) - Attaches to a pin setting min and max values in microseconds
     default min is 544, max is 2400
+    attachPWM(pin ) - Attaches to a pin using TCA0 hardware PWM if the pin is WO0, WO1 or WO2
+    attachPWM(pin, min, max  ) - As above, but also sets min and max values
 
     write()     - Sets the servo angle in degrees.  (invalid angle that is valid as pulse in microseconds is treated as microseconds)
     writeMicroseconds() - Sets the servo pulse width in microseconds
@@ -43,6 +45,10 @@
     readMicroseconds()   - Gets the last written servo pulse width in microseconds. (was read_us() in first release)
     attached()  - Returns true if there is a servo attached.
     detach()    - Stops an attached servos from pulsing its i/o pin.
+    moveTo()    - Moves to an angle or pulse width in the background, limited by the speed and acceleration set.
+    setSpeed()  - Sets the maximum speed used by moveTo() in degrees per second.
+    setAcceleration() - Sets the acceleration and deceleration used by moveTo() in degrees per second squared.
+    isMoving()  - Returns true while moveTo() is moving the servo.
  */
 
 #ifndef Servo_h
@@ -74,10 +80,15 @@
 #define DEFAULT_PULSE_WIDTH  1500      // default pulse width when servo is attached
 #define REFRESH_INTERVAL     20000UL   // minumim time to refresh servos in microseconds
 
+#if ((RAMEND - RAMSTART) < 2047)
 #define SERVOS_PER_TIMER     12        // the maximum number of servos controlled by one timer
+#else
+#define SERVOS_PER_TIMER     24        // the maximum number of servos controlled by one timer
+#endif
 #define MAX_SERVOS   (_Nbr_16timers  * SERVOS_PER_TIMER)
 
 #define INVALID_SERVO        255       // flag indicating an invalid servo index
+#define SERVO_NO_PWM         255       // flag indicating a servo pulsed by the timer interrupt
 
 typedef struct  {
   //uint8_t nbr;                       // a pin number from 0 to 63
@@ -87,11 +98,26 @@ typedef struct  {
   uint8_t isActive;                    // true if this channel is enabled, pin not pulsed if false
   uint8_t port;
   uint8_t bitmask;
+  uint8_t pwmChannel;                  // TCA0 compare channel generating the pulse, or SERVO_NO_PWM
 } ServoPin_t;
 
+// Motion profile, advanced by the timer interrupt once every refresh interval.
+// Speeds are in 1/16 timer ticks per refresh interval, and accelerations in
+// 1/16 timer ticks per refresh interval squared
+typedef struct {
+  uint16_t target;                     // pulse width to move to, in timer ticks
+  uint16_t speed;                      // maximum speed, 0 for no limit
+  uint16_t acceleration;               // 0 to move at full speed right away
+  uint16_t velocity;                   // current speed
+  uint32_t position;                   // current pulse width, in 1/16 timer ticks
+  uint32_t brake;                      // distance needed to stop from the current speed
+  volatile int8_t direction;           // 1 or -1 while moving, 0 when standing still
+} ServoMotion_t;
+
 typedef struct {
   ServoPin_t Pin;
   volatile uint16_t ticks;
+  ServoMotion_t *motion;
 } servo_t;
 
 class Servo {
@@ -99,13 +125,21 @@ class Servo {
     Servo();
     uint8_t attach(uint8_t pin);                           // attach the given pin to the next free channel, sets pinMode, returns channel number or 0 if failure
     uint8_t attach(uint8_t pin, int16_t min, int16_t max); // as above but also sets min and max values for writes.
+    uint8_t attachPWM(uint8_t pin);                        // attach using TCA0 hardware PWM if possible, otherwise same as attach()
+    uint8_t attachPWM(uint8_t pin, int16_t min, int16_t max); // as above but also sets min and max values for writes.
     void detach();
     void write(uint16_t value);                            // if value is < 200 its treated as an angle, otherwise as pulse width in microseconds
     void writeMicroseconds(uint16_t value);                // Write pulse width in microseconds
     int16_t read();                                        // returns current pulse width as an angle between 0 and 180 degrees
     uint16_t readMicroseconds();                           // returns current pulse width in microseconds for this servo (was read_us() in first release)
     bool attached();                                       // return true if this servo is attached, otherwise false
+    void moveTo(uint16_t value);                           // move smoothly to an angle or pulse width, using the speed and acceleration set
+    void setSpeed(uint16_t speed);                         // maximum speed in degrees per second for moveTo(), 0 for no limit
+    void setAcceleration(uint16_t acceleration);           // acceleration in degrees per second squared for moveTo(), 0 for none
+    bool isMoving();                                       // return true while moveTo() hasn't reached its target
   private:
+    uint16_t pulseWidth(uint16_t value);                   // angle or pulse width to a valid pulse width in microseconds
+    ServoMotion_t motion;
     uint8_t servoIndex;                                    // index into the channel data for this servo
     int8_t min;                                            // minimum is this value times 4 added to MIN_PULSE_WIDTH
     int8_t max;                                            // maximum is this value times 4 added to MAX_PULSE_WIDTH
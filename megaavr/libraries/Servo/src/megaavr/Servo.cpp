@@ -6,18 +6,49 @@
 #if (F_CPU > 10000000L)
   #define usToTicks(_us)    ((( (_us) / 2) * clockCyclesPerMicrosecond()))          // converts microseconds to tick
   #define ticksToUs(_ticks) (((unsigned) (_ticks) * 2) / clockCyclesPerMicrosecond()) // converts from ticks back to microseconds
-  #define TRIM_DURATION  37                                                         // compensation ticks to trim adjust for digitalWrite delays
 #else
   #define usToTicks(_us)    ((( _us ) * clockCyclesPerMicrosecond()))               // converts microseconds to tick
   #define ticksToUs(_ticks) (((unsigned) _ticks ) / clockCyclesPerMicrosecond())    // converts from ticks back to microseconds
-  #define TRIM_DURATION  74                                                         // compensation ticks to trim adjust for digitalWrite delays
 #endif
 
+#define EDGE_MARGIN  usToTicks(4)   // pulses ending closer than this to the current time are ended without leaving the ISR
+
+// Servos attached with attachPWM() are pulsed by TCA0 in single (16-bit) mode.
+// The prescaler is the lowest one that fits the refresh interval in 16 bits
+#if (F_CPU / 50) <= 65536UL
+  #define SERVO_TCA_DIV     1
+  #define SERVO_TCA_CLKSEL  TCA_SINGLE_CLKSEL_DIV1_gc
+#elif (F_CPU / 100) <= 65536UL
+  #define SERVO_TCA_DIV     2
+  #define SERVO_TCA_CLKSEL  TCA_SINGLE_CLKSEL_DIV2_gc
+#elif (F_CPU / 200) <= 65536UL
+  #define SERVO_TCA_DIV     4
+  #define SERVO_TCA_CLKSEL  TCA_SINGLE_CLKSEL_DIV4_gc
+#else
+  #define SERVO_TCA_DIV     8
+  #define SERVO_TCA_CLKSEL  TCA_SINGLE_CLKSEL_DIV8_gc
+#endif
+#define usToPwmTicks(_us) ((uint32_t)(_us) * (F_CPU / SERVO_TCA_DIV / 1000) / 1000)   // converts microseconds to TCA0 ticks
+
+static uint8_t pwmChannelsUsed = 0;                      // TCA0 compare channels used by servos
+static uint8_t savedTCAClksel;                           // TCA0 prescaler and route before the first PWM servo was attached
+static uint8_t savedTCARoute;
+
 static servo_t servos[MAX_SERVOS];                       // static array of servo structures
 
 uint8_t ServoCount = 0;                                  // the total number of attached servos
 
-static volatile int8_t currentServoIndex[_Nbr_16timers]; // index for the servo being pulsed for each timer (or -1 if refresh interval)
+// All servos on a timer start their pulse at the same time at the beginning of
+// each refresh interval, and each pulse is ended at its own compare time. The
+// pulse widths are copied at the start of the interval, and the servos are kept
+// sorted by pulse width. Pulses ending at the same time, or too close to wait
+// for another interrupt, are ended in the same interrupt
+static uint8_t servoOrder[_Nbr_16timers][SERVOS_PER_TIMER];      // channels sorted by the time their pulse ends
+static uint16_t servoEdge[_Nbr_16timers][SERVOS_PER_TIMER];      // pulse end for each channel in this refresh interval
+static volatile uint8_t servoPortMask[_Nbr_16timers][NUM_TOTAL_PORTS]; // pins to pulse on each port
+static uint8_t nextEdge[_Nbr_16timers];                          // position in servoOrder of the next pulse to end
+static uint8_t edgeCount[_Nbr_16timers];                         // number of channels in servoOrder this interval
+static uint32_t currentCycleTicks[_Nbr_16timers];                // ticks from the start of the interval to the last compare match
 
 // convenience macros
 #define SERVO_INDEX_TO_TIMER(_servo_nbr) ((timer16_Sequence_t)(_servo_nbr / SERVOS_PER_TIMER))   // returns the timer controlling this servo
@@ -28,57 +59,195 @@ static volatile int8_t currentServoIndex[_Nbr_16timers]; // index for the servo
 #define SERVO_MIN() (MIN_PULSE_WIDTH - this->min * 4)   // minimum value in uS for this servo
 #define SERVO_MAX() (MAX_PULSE_WIDTH - this->max * 4)   // maximum value in uS for this servo
 
-void ServoHandler(int16_t timer) {
-  static uint32_t currentCycleTicks = 0;
-  if (currentServoIndex[timer] < 0) {
-    // we're at servo index -1... but before we go further - we need to see if we've waited through a refresh cycle...
-    if (currentCycleTicks < usToTicks(REFRESH_INTERVAL)) {
-      uint32_t tval=usToTicks(REFRESH_INTERVAL)-currentCycleTicks;
-      uint16_t tval16=(tval>65535)?65535:tval;
-      _timer->CCMP = tval16;
-      currentCycleTicks+=tval16;
-      // wait longer, and terminate the ISR without further action./* Clear flag */
-      _timer->INTFLAGS = TCB_CAPT_bm;
-      return;
-    } else {
-      // current cycle is done, so reset the currentCycleTicks, and run the rest of things...
-      currentCycleTicks=0;
-    }
-  } else {
-    if (SERVO_INDEX(timer, currentServoIndex[timer]) < ServoCount && SERVO(timer, currentServoIndex[timer]).Pin.isActive == true) {
-      //digitalWrite(SERVO(timer, currentServoIndex[timer]).Pin.nbr, LOW);   // pulse this channel low if activated
-      ((PORT_t *)&PORTA + SERVO(timer, currentServoIndex[timer]).Pin.port)->OUTCLR = SERVO(timer, currentServoIndex[timer]).Pin.bitmask;
+static inline bool isPulsedByISR(const servo_t &servo) {
+  return servo.Pin.isActive == true && servo.Pin.pwmChannel == SERVO_NO_PWM;
+}
+
+static inline bool isISRRunning() {
+  return _timer->INTCTRL & TCB_CAPTEI_bm;
+}
+
+static bool isISRNeeded(timer16_Sequence_t timer) {
+  // The interrupt pulses the servos not driven by TCA0, and runs moveTo()
+  for (uint8_t channel = 0; channel < SERVOS_PER_TIMER; channel++) {
+    if (SERVO_INDEX(timer, channel) >= ServoCount)
+      break;
+    servo_t &servo = SERVO(timer, channel);
+    if (isPulsedByISR(servo) || (servo.Pin.isActive == true && servo.motion->direction != 0))
+      return true;
+  }
+  return false;
+}
+
+static void startCycle(int16_t timer) {
+  // Start all pulses at once, one write per port
+  for (uint8_t port = 0; port < NUM_TOTAL_PORTS; port++) {
+    uint8_t mask = servoPortMask[timer][port];
+    if (mask)
+      ((PORT_t *)&PORTA + port)->OUTSET = mask;
+  }
+  // Pulse widths are counted from when the pins were actually set
+  uint16_t start = _timer->CNT;
+
+  uint8_t count = ServoCount - timer * SERVOS_PER_TIMER;
+  if (count > SERVOS_PER_TIMER)
+    count = SERVOS_PER_TIMER;
+  edgeCount[timer] = count;
+
+  uint8_t *order = servoOrder[timer];
+  uint16_t *edge = servoEdge[timer];
+  for (uint8_t channel = 0; channel < count; channel++)
+    edge[channel] = SERVO(timer, channel).ticks + start;
+
+  // Insertion sort. The order rarely changes between intervals, so this is
+  // usually a single pass
+  for (uint8_t i = 1; i < count; i++) {
+    uint8_t channel = order[i];
+    uint8_t j = i;
+    while (j > 0 && edge[order[j - 1]] > edge[channel]) {
+      order[j] = order[j - 1];
+      j--;
     }
+    order[j] = channel;
   }
 
-  // Select the next servo controlled by this timer
-  currentServoIndex[timer]++;
+  nextEdge[timer] = 0;
+  currentCycleTicks[timer] = 0;
+}
 
-  if (SERVO_INDEX(timer, currentServoIndex[timer]) < ServoCount && currentServoIndex[timer] < SERVOS_PER_TIMER) {
-    if (SERVO(timer, currentServoIndex[timer]).Pin.isActive == true) {   // check if activated
-      //digitalWrite(SERVO(timer, currentServoIndex[timer]).Pin.nbr, HIGH);   // it's an active channel so pulse it high
-      ((PORT_t *)&PORTA + SERVO(timer, currentServoIndex[timer]).Pin.port)->OUTSET = SERVO(timer, currentServoIndex[timer]).Pin.bitmask;
-    }
+static void setTicks(servo_t &servo, uint16_t ticks) {
+  servo.ticks = ticks;
+  uint8_t pwmChannel = servo.Pin.pwmChannel;
+  if (pwmChannel != SERVO_NO_PWM)
+    (&TCA0.SINGLE.CMP0BUF)[pwmChannel] = usToPwmTicks(ticksToUs(ticks));
+}
 
-    // Get the counter value
-    _timer->CCMP = SERVO(timer, currentServoIndex[timer]).ticks;
-    currentCycleTicks += SERVO(timer, currentServoIndex[timer]).ticks;
+// Moves the servo one refresh interval closer to its target. The brake distance
+// is the sum of the speeds on the way down to zero, which lets the servo
+// decelerate in time using additions only
+static void advanceMotion(servo_t &servo) {
+  ServoMotion_t *m = servo.motion;
+  uint32_t target = (uint32_t)m->target << 4;
+  uint32_t remaining;
+  int8_t dir;
+  if (target >= m->position) {
+    remaining = target - m->position;
+    dir = 1;
   } else {
-    // finished all channels so wait for the refresh period to expire before starting over
-    if (currentCycleTicks + 100 < usToTicks(REFRESH_INTERVAL)) {   // let's not bother if it's gonna take less than 100 ticks for the next
-      uint32_t tval = usToTicks(REFRESH_INTERVAL) - currentCycleTicks;
-      uint16_t tval16 = tval > 65535 ? 65535 : tval;
+    remaining = m->position - target;
+    dir = -1;
+  }
+
+  if (m->velocity == 0)
+    m->direction = dir;
+  // The target has moved behind the servo, so stop before turning around
+  bool turn = (dir != m->direction);
+
+  uint16_t v = m->velocity;
+  if (m->acceleration == 0) {
+    // Without acceleration there is nothing to slow down, turn around at once
+    m->direction = dir;
+    turn = false;
+    v = m->speed;
+  } else if (turn || m->brake >= remaining) {
+    m->brake = (m->brake > v) ? m->brake - v : 0;
+    v = (v > m->acceleration) ? v - m->acceleration : 0;
+  } else if (v < m->speed) {
+    v = (m->speed - v > m->acceleration) ? v + m->acceleration : m->speed;
+    m->brake += v;
+  }
+
+  if (!turn && v >= remaining) {
+    // Arrived
+    m->position = target;
+    m->velocity = 0;
+    m->brake = 0;
+    m->direction = 0;
+  } else {
+    if (m->direction > 0)
+      m->position += v;
+    else
+      m->position -= v;
+    m->velocity = v;
+  }
+  setTicks(servo, m->position >> 4);
+}
+
+static void finISR();
+
+void ServoHandler(int16_t timer) {
+  if (nextEdge[timer] >= edgeCount[timer]) {
+    // All pulses have ended, but we need to see if we've waited through a refresh cycle...
+    if (currentCycleTicks[timer] < usToTicks(REFRESH_INTERVAL)) {
+      uint32_t tval = usToTicks(REFRESH_INTERVAL) - currentCycleTicks[timer];
+      uint16_t tval16 = (tval > 65535) ? 65535 : tval;
       _timer->CCMP = tval16;
-      currentCycleTicks += tval16;
-    } else { // in this case it's less than 100 ticks for next interval, so we just set it to that...
-      currentCycleTicks = usToTicks(REFRESH_INTERVAL);
+      currentCycleTicks[timer] += tval16;
+      // wait longer, and terminate the ISR without further action
+      _timer->INTFLAGS = TCB_CAPT_bm;
+      return;
+    }
+    startCycle(timer);
+  }
+
+  // CCMP still holds the previous interval, and the counter would restart
+  // when it gets there. Let it run freely from the compare match that got
+  // us here, so the wait for an edge below can't miss it
+  _timer->CCMP = 0xFFFF;
+
+  const uint8_t *order = servoOrder[timer];
+  const uint16_t *edge = servoEdge[timer];
+  while (nextEdge[timer] < edgeCount[timer]) {
+    uint8_t channel = order[nextEdge[timer]];
+    if (isPulsedByISR(SERVO(timer, channel))) {
+      // Ticks from the last compare match, where the counter started from zero
+      uint16_t tval16 = edge[channel] - currentCycleTicks[timer];
+      if (tval16 > _timer->CNT + EDGE_MARGIN) {
+        // Far enough away to let the timer interrupt again
+        _timer->CCMP = tval16;
+        currentCycleTicks[timer] += tval16;
+        _timer->INTFLAGS = TCB_CAPT_bm;
+        return;
+      }
+      while (_timer->CNT < tval16);
+      ((PORT_t *)&PORTA + SERVO(timer, channel).Pin.port)->OUTCLR = SERVO(timer, channel).Pin.bitmask;
     }
-    currentServoIndex[timer] = -1;   // this will get incremented at the end of the refresh period to start again at the first channel
+    nextEdge[timer]++;
   }
+
+  // finished all channels so wait for the refresh period to expire before starting over
+  uint32_t tval = usToTicks(REFRESH_INTERVAL) - currentCycleTicks[timer];
+  uint16_t tval16 = tval > 65535 ? 65535 : tval;
+  _timer->CCMP = tval16;
+  currentCycleTicks[timer] += tval16;
+
   /* Clear flag */
   _timer->INTFLAGS = TCB_CAPT_bm;
+
+  // All pulses are done, so this is a good time to move the servos for the
+  // next refresh interval
+  for (uint8_t channel = 0; channel < edgeCount[timer]; channel++) {
+    servo_t &servo = SERVO(timer, channel);
+    if (servo.Pin.isActive == true && servo.motion->direction != 0)
+      advanceMotion(servo);
+  }
+
+  // Servos pulsed by TCA0 cost no interrupts once they have settled
+  if (!isISRNeeded((timer16_Sequence_t)timer))
+    finISR();
 }
 
+// Keep tone() off the servo timer
+#if defined(SERVO_USE_TIMERB0)
+TCB_CLAIM(0);
+#elif defined(SERVO_USE_TIMERB1)
+TCB_CLAIM(1);
+#elif defined(SERVO_USE_TIMERB2)
+TCB_CLAIM(2);
+#elif defined(SERVO_USE_TIMERB3)
+TCB_CLAIM(3);
+#endif
+
 #if defined(SERVO_USE_TIMERB0)
 ISR(TCB0_INT_vect)
 #elif defined(SERVO_USE_TIMERB1)
@@ -104,6 +273,9 @@ static void initISR() {
   _timer->CTRLB = TCB_CNTMODE_INT_gc;
 
   _timer->CCMP = 0x8000; //Experience has shown that without this, it goes off the rails
+  // Start a new refresh cycle on the first interrupt
+  nextEdge[timer0] = edgeCount[timer0] = 0;
+  currentCycleTicks[timer0] = usToTicks(REFRESH_INTERVAL);
   // Enable interrupt
   _timer->INTCTRL = TCB_CAPTEI_bm;
   // Enable timer
@@ -115,22 +287,50 @@ static void finISR() {
   _timer->INTCTRL = 0;
 }
 
-static bool isTimerActive(timer16_Sequence_t timer) {
-  // returns true if any servo is active on this timer
+static void initPWM(uint8_t port) {
+  savedTCAClksel = TCA0.SINGLE.CTRLA & TCA_SINGLE_CLKSEL_gm;
+  savedTCARoute = PORTMUX.TCAROUTEA;
+
+  // One PWM period per refresh interval. The compare buffer registers make
+  // sure a new pulse width never takes effect in the middle of a pulse
+  pwmSetMode(TCA_SINGLE_MODE);
+  PORTMUX.TCAROUTEA = port;
+  TCA0.SINGLE.CTRLA = 0;
+  TCA0.SINGLE.CNT = 0;
+  TCA0.SINGLE.PER = usToPwmTicks(REFRESH_INTERVAL) - 1;
+  TCA0.SINGLE.CTRLA = SERVO_TCA_CLKSEL | TCA_SINGLE_ENABLE_bm;
+}
+
+static void finPWM() {
+  // Back to the default PWM configuration used by analogWrite()
+  pwmSetMode(TCA_SPLIT_MODE);
+  pwmPrescaler(TCA0_0, (timers_prescaler_t)savedTCAClksel);
+  PORTMUX.TCAROUTEA = savedTCARoute;
+}
+
+static void updatePortMask(timer16_Sequence_t timer) {
+  // Pins set at the start of each refresh cycle
+  uint8_t mask[NUM_TOTAL_PORTS] = {0};
   for (uint8_t channel = 0; channel < SERVOS_PER_TIMER; channel++) {
-    if (SERVO(timer, channel).Pin.isActive == true) {
-      return true;
-    }
+    if (SERVO_INDEX(timer, channel) < ServoCount && isPulsedByISR(SERVO(timer, channel)))
+      mask[SERVO(timer, channel).Pin.port] |= SERVO(timer, channel).Pin.bitmask;
   }
-  return false;
+  uint8_t status = SREG;
+  cli();
+  for (uint8_t port = 0; port < NUM_TOTAL_PORTS; port++)
+    servoPortMask[timer][port] = mask[port];
+  SREG = status;
 }
 
 /****************** end of static functions ******************************/
 
-Servo::Servo() {
+Servo::Servo() : motion() {
   if (ServoCount < MAX_SERVOS) {
     this->servoIndex = ServoCount++;                    // assign a servo index to this instance
     servos[this->servoIndex].ticks = usToTicks(DEFAULT_PULSE_WIDTH);   // store default values
+    servos[this->servoIndex].Pin.pwmChannel = SERVO_NO_PWM;
+    servos[this->servoIndex].motion = &this->motion;
+    servoOrder[SERVO_INDEX_TO_TIMER(this->servoIndex)][SERVO_INDEX_TO_CHANNEL(this->servoIndex)] = SERVO_INDEX_TO_CHANNEL(this->servoIndex);
   } else {
     this->servoIndex = INVALID_SERVO;  // too many servos
   }
@@ -144,6 +344,8 @@ uint8_t Servo::attach(uint8_t pin, int16_t min, int16_t max) {
   timer16_Sequence_t timer;
 
   if (this->servoIndex < MAX_SERVOS) {
+    if (servos[this->servoIndex].Pin.pwmChannel != SERVO_NO_PWM)
+      this->detach();
     //pinMode(pin, OUTPUT);                    // set servo pin to output
     //servos[this->servoIndex].Pin.nbr = pin;
     uint8_t bitmask = digitalPinToBitMask(pin);
@@ -157,27 +359,95 @@ uint8_t Servo::attach(uint8_t pin, int16_t min, int16_t max) {
     // todo min/max check: abs(min - MIN_PULSE_WIDTH) /4 < 128
     this->min = (MIN_PULSE_WIDTH - min) / 4; //resolution of min/max is 4 uS
     this->max = (MAX_PULSE_WIDTH - max) / 4;
-    // initialize the timer if it has not already been initialized
     timer = SERVO_INDEX_TO_TIMER(servoIndex);
-    if (isTimerActive(timer) == false) {
+    // Start the interrupt if it isn't running. Interrupts are off, so it
+    // can't stop in between because it hasn't seen this servo yet
+    uint8_t status = SREG;
+    cli();
+    servos[this->servoIndex].Pin.isActive = true;
+    if (!isISRRunning())
       initISR();
-    }
-    servos[this->servoIndex].Pin.isActive = true;  // this must be set after the check for isTimerActive
+    SREG = status;
+    updatePortMask(timer);
   }
   return this->servoIndex;
 }
 
+uint8_t Servo::attachPWM(uint8_t pin) {
+  return this->attachPWM(pin, MIN_PULSE_WIDTH, MAX_PULSE_WIDTH);
+}
+
+uint8_t Servo::attachPWM(uint8_t pin, int16_t min, int16_t max) {
+  if (this->servoIndex >= MAX_SERVOS)
+    return this->servoIndex;
+
+  // TCA0 WO0-2 are pin 0-2 on the port TCA0 is routed to. All PWM servos
+  // have to share the same port, so fall back to the interrupt otherwise
+  uint8_t prt = digitalPinToPort(pin);
+  uint8_t channel = digitalPinToBitPosition(pin);
+  if (prt == NOT_A_PORT || channel >= 3
+   || (pwmChannelsUsed && (prt != PORTMUX.TCAROUTEA || (pwmChannelsUsed & (1 << channel)))))
+    return this->attach(pin, min, max);
+
+  if (servos[this->servoIndex].Pin.isActive == true)
+    this->detach();
+
+  this->min = (MIN_PULSE_WIDTH - min) / 4; //resolution of min/max is 4 uS
+  this->max = (MAX_PULSE_WIDTH - max) / 4;
+
+  if (pwmChannelsUsed == 0)
+    initPWM(prt);
+  pwmChannelsUsed |= (1 << channel);
+
+  servos[this->servoIndex].Pin.bitmask = digitalPinToBitMask(pin);
+  servos[this->servoIndex].Pin.port = prt;
+  servos[this->servoIndex].Pin.pwmChannel = channel;
+  ((PORT_t *)&PORTA + prt)->DIRSET = servos[this->servoIndex].Pin.bitmask;
+
+  // Start out with the last written pulse width. The output is off, so the
+  // compare register can be written directly
+  this->writeMicroseconds(this->readMicroseconds());
+  uint8_t status = SREG;
+  cli();
+  (&TCA0.SINGLE.CMP0)[channel] = (&TCA0.SINGLE.CMP0BUF)[channel];
+  SREG = status;
+  TCA0.SINGLE.CTRLB |= (1 << (TCA_SINGLE_CMP0EN_bp + channel));
+
+  // No interrupt is needed, unless moveTo() is used later
+  servos[this->servoIndex].Pin.isActive = true;
+  return this->servoIndex;
+}
+
 void Servo::detach() {
   timer16_Sequence_t timer;
 
+  bool pulsedByISR = isPulsedByISR(servos[this->servoIndex]);
   servos[this->servoIndex].Pin.isActive = false;
+  motion.direction = 0;
   timer = SERVO_INDEX_TO_TIMER(servoIndex);
-  if (isTimerActive(timer) == false) {
+  updatePortMask(timer);
+  // Don't leave the pin high if the servo is detached in the middle of a pulse
+  if (pulsedByISR)
+    ((PORT_t *)&PORTA + servos[this->servoIndex].Pin.port)->OUTCLR = servos[this->servoIndex].Pin.bitmask;
+
+  uint8_t channel = servos[this->servoIndex].Pin.pwmChannel;
+  if (channel != SERVO_NO_PWM) {
+    servos[this->servoIndex].Pin.pwmChannel = SERVO_NO_PWM;
+    TCA0.SINGLE.CTRLB &= ~(1 << (TCA_SINGLE_CMP0EN_bp + channel));
+    pwmChannelsUsed &= ~(1 << channel);
+    if (pwmChannelsUsed == 0)
+      finPWM();
+  }
+  if (!isISRNeeded(timer)) {
     finISR();
   }
 }
 
 void Servo::write(uint16_t value) {
+  writeMicroseconds(pulseWidth(value));
+}
+
+uint16_t Servo::pulseWidth(uint16_t value) {
   // treat values less than 544 as angles in degrees (valid values in microseconds are handled as microseconds)
   if (value < MIN_PULSE_WIDTH) {
     // ditch this, the argument is an unsigned int, so this is pointless...
@@ -190,9 +460,14 @@ void Servo::write(uint16_t value) {
 
     value = map(value, 0, 180, SERVO_MIN(), SERVO_MAX());
   }
-  writeMicroseconds(value);
-}
 
+  if (value < (uint16_t) SERVO_MIN()) {        // ensure pulse width is valid
+    value = SERVO_MIN();
+  } else if (value > (uint16_t) SERVO_MAX()) {
+    value = SERVO_MAX();
+  }
+  return value;
+}
 
 void Servo::writeMicroseconds(uint16_t value) {
   // calculate and store the values for the given channel
@@ -204,10 +479,20 @@ void Servo::writeMicroseconds(uint16_t value) {
       value = SERVO_MAX();
     }
 
+    // Stop any ongoing moveTo()
+    motion.direction = 0;
 
-    value = usToTicks(value);  // convert to ticks BEFORE compensating for interrupt overhead
-    value = value - TRIM_DURATION;
-    servos[channel].ticks = value;
+
+    uint8_t pwmChannel = servos[channel].Pin.pwmChannel;
+    if (pwmChannel != SERVO_NO_PWM) {
+      // Copied to the compare register at the start of the next period
+      uint8_t status = SREG;
+      cli();
+      (&TCA0.SINGLE.CMP0BUF)[pwmChannel] = usToPwmTicks(value);
+      SREG = status;
+    }
+
+    servos[channel].ticks = usToTicks(value);
   }
 }
 
@@ -218,7 +503,7 @@ int16_t Servo::read() { // return the value as degrees
 uint16_t Servo::readMicroseconds() {
   uint16_t pulsewidth;
   if (this->servoIndex != INVALID_SERVO) {
-    pulsewidth = ticksToUs(servos[this->servoIndex].ticks + TRIM_DURATION);
+    pulsewidth = ticksToUs(servos[this->servoIndex].ticks);
   } else {
     pulsewidth  = 0;
   }
@@ -228,4 +513,65 @@ uint16_t Servo::readMicroseconds() {
 bool Servo::attached() {
   return servos[this->servoIndex].Pin.isActive;
 }
+void Servo::moveTo(uint16_t value) {
+  uint8_t channel = this->servoIndex;
+  if (channel >= MAX_SERVOS)
+    return;
+
+  value = pulseWidth(value);
+  if (motion.speed == 0) {
+    writeMicroseconds(value);
+    return;
+  }
+
+  uint8_t status = SREG;
+  cli();
+  if (motion.direction == 0) {
+    // Start moving from where the servo is now
+    motion.position = (uint32_t)servos[channel].ticks << 4;
+    motion.velocity = 0;
+    motion.brake = 0;
+    motion.direction = 1;
+  }
+  motion.target = usToTicks(value);
+  // The ramp runs from the timer interrupt, which is stopped while only
+  // settled TCA0 servos are attached
+  if (servos[channel].Pin.isActive == true && !isISRRunning())
+    initISR();
+  SREG = status;
+}
+
+// Converts from degrees per second to 1/16 timer ticks per refresh interval
+void Servo::setSpeed(uint16_t speed) {
+  uint32_t ticksPerSecond = (uint32_t)speed * (usToTicks(SERVO_MAX()) - usToTicks(SERVO_MIN())) / 180;
+  uint32_t value = ticksPerSecond * 16 / (1000000UL / REFRESH_INTERVAL);
+  if (value > 0xFFFF)
+    value = 0xFFFF;
+  else if (value == 0 && speed)
+    value = 1;
+
+  uint8_t status = SREG;
+  cli();
+  motion.speed = value;
+  SREG = status;
+}
+
+// Converts from degrees per second squared to 1/16 timer ticks per refresh interval squared
+void Servo::setAcceleration(uint16_t acceleration) {
+  uint32_t ticksPerSecond2 = (uint32_t)acceleration * (usToTicks(SERVO_MAX()) - usToTicks(SERVO_MIN())) / 180;
+  uint32_t value = ticksPerSecond2 * 16 / ((1000000UL / REFRESH_INTERVAL) * (1000000UL / REFRESH_INTERVAL));
+  if (value > 0xFFFF)
+    value = 0xFFFF;
+  else if (value == 0 && acceleration)
+    value = 1;
+
+  uint8_t status = SREG;
+  cli();
+  motion.acceleration = value;
+  SREG = status;
+}
+
+bool Servo::isMoving() {
+  return motion.direction != 0;
+}
 #endif
@@ -0,0 +1,59 @@
+// Wire Async Reader
+
+// Demonstrates non-blocking use of the Wire library
+// Reads a block of registers from an I2C/TWI device in the background,
+// while the main loop keeps running
+
+// The register read is queued with Wire.writeReadAsync(), which first writes
+// the register address and then reads the data after a repeated start. The
+// transfer runs from the TWI interrupt, and the callback is called from the
+// interrupt when it's done. Wire.done() can be polled instead, and
+// Wire.wait() blocks until the transaction has finished
+
+// This example code is in the public domain.
+
+
+#include <Wire.h>
+
+const uint8_t deviceAddress = 0x68;  // e.g. an MPU-6050 IMU
+const uint8_t firstRegister = 0x3B;  // accelerometer, temperature and gyro data
+
+TWI_Transaction_t transaction;
+uint8_t data[14];
+volatile bool dataReady = false;
+uint32_t loopsWhileReading = 0;
+
+void readDone(TWI_Transaction_t *t) {
+  dataReady = true;
+}
+
+void startRead() {
+  Wire.writeReadAsync(&transaction, deviceAddress, &firstRegister, 1, data, sizeof(data), readDone);
+}
+
+void setup() {
+  Wire.begin();        // join i2c bus
+  Serial.begin(9600);  // start serial for output
+  startRead();
+}
+
+void loop() {
+  if (dataReady) {
+    dataReady = false;
+    if (transaction.result == TWIM_RESULT_OK) {
+      Serial.print("Read ");
+      Serial.print(transaction.bytes_read);
+      Serial.print(" bytes while the loop ran ");
+      Serial.print(loopsWhileReading);
+      Serial.println(" times");
+    } else {
+      Serial.println("Read failed");
+    }
+    loopsWhileReading = 0;
+    delay(500);
+    startRead();
+  }
+
+  // Do other work while the transfer is running
+  loopsWhileReading++;
+}
@@ -0,0 +1,65 @@
+// Wire Dual Mode
+
+// Demonstrates running the Wire master and slave at the same time
+// The microcontroller acts as a sensor hub. It polls a sensor on its own
+// bus as a master, and answers a host on a second bus as a slave
+
+// enableDualMode() moves the slave to its own pins, PC2 (SDA) and PC3 (SCL)
+// with the master on the default pins. Without it, the master and the slave
+// share the same bus. The slave has its own buffers, so a host request never
+// disturbs a master transfer in progress
+
+// With the master running, available() and read() return master data
+// outside the slave callbacks. Data the host wrote to us is read from loop()
+// with slaveAvailable() and slaveRead() instead
+
+// This example code is in the public domain.
+
+
+#include <Wire.h>
+
+const uint8_t hubAddress = 0x42;     // our address on the host bus
+const uint8_t sensorAddress = 0x48;  // e.g. a TMP102 temperature sensor
+
+volatile uint8_t latest[2];
+volatile bool hostWrote = false;
+uint8_t pollInterval = 100;          // ms, can be changed by the host
+
+void setup() {
+  Wire.begin();                // master on the sensor bus
+  Wire.enableDualMode();       // slave on separate pins
+  Wire.begin(hubAddress);      // slave on the host bus
+  Wire.onRequest(requestEvent);
+  Wire.onReceive(receiveEvent);
+}
+
+void loop() {
+  // Poll the sensor as a master
+  if (Wire.requestFrom(sensorAddress, (uint8_t)2) == 2) {
+    uint8_t msb = Wire.read();
+    uint8_t lsb = Wire.read();
+    noInterrupts();
+    latest[0] = msb;
+    latest[1] = lsb;
+    interrupts();
+  }
+
+  // The host can write a new poll interval
+  if (hostWrote) {
+    hostWrote = false;
+    if (Wire.slaveAvailable())
+      pollInterval = Wire.slaveRead();
+  }
+  delay(pollInterval);
+}
+
+// Called from the TWI interrupt when the host reads from us
+void requestEvent() {
+  Wire.write(latest[0]);
+  Wire.write(latest[1]);
+}
+
+// Called from the TWI interrupt when the host writes to us
+void receiveEvent(int howMany) {
+  hostWrote = true;
+}
@@ -0,0 +1,51 @@
+// Wire Register Map
+
+// Demonstrates serving I2C registers straight from the TWI interrupt
+// The slave answers to two addresses, each with its own register map. The
+// master writes a register number followed by data, or writes a register
+// number and reads from it after a repeated start, like most I2C sensors.
+// The interrupt handles all of it, so the master never has to wait for
+// the sketch
+
+// The third argument to begin() goes straight into the SADDRMASK register.
+// Shifting an address left by one and setting TWI_ADDREN_bm makes it a
+// second address, while leaving out TWI_ADDREN_bm makes it an address mask
+
+// This example code is in the public domain.
+
+
+#include <Wire.h>
+
+const uint8_t sensorAddress = 0x20;
+const uint8_t configAddress = 0x21;
+
+// Sensor map: a read-only ID register and two measurement registers
+volatile uint8_t sensorId = 0xA5;
+volatile uint8_t sensorValue[2];
+volatile uint8_t *const sensorRegisters[] = { &sensorId, &sensorValue[0], &sensorValue[1] };
+
+// Config map: the master may change the low nibble of the first register
+// and all of the second one
+volatile uint8_t config[2];
+volatile uint8_t *const configRegisters[] = { &config[0], &config[1] };
+const uint8_t configWriteMasks[] = { 0x0F, 0xFF };
+
+TWI_RegisterMap_t sensorMap = { sensorAddress, sensorRegisters, NULL, 3, 0 };
+TWI_RegisterMap_t configMap = { configAddress, configRegisters, configWriteMasks, 2, 0 };
+
+void setup() {
+  Wire.begin(sensorAddress, false, (configAddress << 1) | TWI_ADDREN_bm);
+  Wire.addRegisterMap(&sensorMap);
+  Wire.addRegisterMap(&configMap);
+}
+
+void loop() {
+  uint16_t value = analogRead(A0);
+  noInterrupts();
+  sensorValue[0] = value >> 8;
+  sensorValue[1] = value;
+  interrupts();
+
+  // The master may change config[] at any time
+  delay(10 + (config[1] & 0x7F));
+}
@@ -43,6 +43,14 @@ uint8_t TwoWire::txBuffer[TWI_BUFFER_SIZE];
 uint8_t TwoWire::txBufferIndex = 0;  //head
 uint8_t TwoWire::txBufferLength = 0; //tail
 
+uint8_t TwoWire::slaveRxBuffer[TWI_BUFFER_SIZE];
+uint8_t TwoWire::slaveRxBufferIndex = 0;
+uint8_t TwoWire::slaveRxBufferLength = 0;
+uint8_t TwoWire::slaveTxBuffer[TWI_BUFFER_SIZE];
+uint8_t TwoWire::slaveTxBufferLength = 0;
+uint8_t TwoWire::slaveCallback = 0;
+uint8_t TwoWire::masterEnabled = 0;
+
 uint8_t TwoWire::transmitting = 0;
 void (*TwoWire::user_onRequest)(void);
 void (*TwoWire::user_onReceive)(int);
@@ -122,21 +130,22 @@ void TwoWire::begin(void)
   txBufferIndex = 0;
   txBufferLength = 0;
 
+  masterEnabled = 1;
   TWI_MasterInit(DEFAULT_FREQUENCY);
 }
 
+// Starts the slave. Calling begin() as well, before or after, runs the
+// master at the same time
 void TwoWire::begin(uint8_t address, bool receive_broadcast, uint8_t second_address)
 {
-  rxBufferIndex = 0;
-  rxBufferLength = 0;
+  slaveRxBufferIndex = 0;
+  slaveRxBufferLength = 0;
+  slaveTxBufferLength = 0;
 
-  txBufferIndex = 0;
-  txBufferLength = 0;
+  TWI_attachSlaveTxEvent(onRequestService, slaveTxBuffer);                // default callback must exist
+  TWI_attachSlaveRxEvent(onReceiveService, slaveRxBuffer, TWI_BUFFER_SIZE); // default callback must exist
 
   TWI_SlaveInit(address, receive_broadcast, second_address);
-
-  TWI_attachSlaveTxEvent(onRequestService, txBuffer);                // default callback must exist
-  TWI_attachSlaveRxEvent(onReceiveService, rxBuffer, TWI_BUFFER_SIZE); // default callback must exist
 }
 
 void TwoWire::begin(int address, bool receive_broadcast, uint8_t second_address)
@@ -167,13 +176,75 @@ void TwoWire::begin(int address)
 void TwoWire::end(void)
 {
   TWI_Disable();
+  masterEnabled = 0;
 }
 
+// Moves the slave to its own pins, so the master and the slave can be on
+// separate buses. Must be called before begin(address). The slave uses
+// PC2 (SDA) and PC3 (SCL) when the master is on the default pins, and PF2
+// and PF3 when the master pins are swapped
+void TwoWire::enableDualMode(bool fmp_enable)
+{
+  TWI_EnableDualMode(fmp_enable);
+}
+
+// The slave buffers are used from the slave callbacks, and whenever the
+// master isn't running
+bool TwoWire::useSlaveBuffers()
+{
+  return slaveCallback || !masterEnabled;
+}
+
+// Frequencies above 400kHz, up to 1MHz, use Fast-mode Plus
 void TwoWire::setClock(uint32_t frequency)
 {
   TWI_MasterSetBaud(frequency);
 }
 
+// Measured SCL rise time in nanoseconds, used to make the clock frequency
+// exact. 0 assumes the slowest rise time the I2C specification allows
+void TwoWire::setRiseTime(uint16_t riseTime)
+{
+  TWI_MasterSetRiseTime(riseTime);
+}
+
+// Estimates the rise time from the bus capacitance in pF and the pull-up
+// resistance in ohms, T_RISE = 0.8473 * R * C
+void TwoWire::setBusCapacitance(uint16_t capacitance, uint16_t pullup)
+{
+  uint32_t riseTime = (uint32_t)capacitance * pullup / 1000;
+  riseTime = riseTime * 847 / 1000;
+  TWI_MasterSetRiseTime(riseTime > 0xFFFF ? 0xFFFF : riseTime);
+}
+
+// Sets how long a transaction may go without any progress on the bus
+// before it's aborted, in microseconds. 0 waits forever. A transaction that
+// times out returns 5 from endTransmission() and sets the timeout flag, and
+// with reset_with_timeout the bus is recovered with recoverBus()
+void TwoWire::setWireTimeout(uint32_t timeout, bool reset_with_timeout)
+{
+  TWI_MasterSetTimeout(timeout, reset_with_timeout);
+}
+
+bool TwoWire::getWireTimeoutFlag(void)
+{
+  return TWI_MasterTimeoutFlag();
+}
+
+void TwoWire::clearWireTimeoutFlag(void)
+{
+  TWI_MasterClearTimeoutFlag();
+}
+
+// Clocks out nine SCL pulses and a STOP, to free a bus held by a slave
+void TwoWire::recoverBus(void)
+{
+  uint8_t status = SREG;
+  cli();
+  TWI_MasterRecoverBus();
+  SREG = status;
+}
+
 uint8_t TwoWire::requestFrom(uint8_t address, size_t quantity, bool sendStop)
 {
   if (quantity > TWI_BUFFER_SIZE)
@@ -272,6 +343,17 @@ uint8_t TwoWire::endTransmission(void)
 // or after beginTransmission(address)
 size_t TwoWire::write(uint8_t data)
 {
+  if (slaveCallback)
+  {
+    if (slaveTxBufferLength >= TWI_BUFFER_SIZE)
+    {
+      setWriteError();
+      return 0;
+    }
+    slaveTxBuffer[slaveTxBufferLength++] = data;
+    return 1;
+  }
+
   /* Check if buffer is full */
   if (txBufferLength >= TWI_BUFFER_SIZE)
   {
@@ -307,6 +389,10 @@ size_t TwoWire::write(const uint8_t *data, size_t quantity)
 // or after requestFrom(address, numBytes)
 int TwoWire::available()
 {
+  if (useSlaveBuffers())
+  {
+    return slaveAvailable();
+  }
   return rxBufferLength - rxBufferIndex;
 }
 
@@ -317,6 +403,11 @@ int TwoWire::read()
 {
   int value = -1;
 
+  if (useSlaveBuffers())
+  {
+    return slaveRead();
+  }
+
   // get each successive byte on each call
   if (rxBufferIndex < rxBufferLength)
   {
@@ -334,6 +425,11 @@ int TwoWire::peek()
 {
   int value = -1;
 
+  if (useSlaveBuffers())
+  {
+    return slavePeek();
+  }
+
   if (rxBufferIndex < rxBufferLength)
   {
     value = rxBuffer[rxBufferIndex];
@@ -342,6 +438,38 @@ int TwoWire::peek()
   return value;
 }
 
+// Read the data from the last slave receive, whether or not the master is
+// running. With both running, available(), read() and peek() only return
+// slave data from inside the onReceive() callback, so these are the way to
+// get at it from loop(). The next receive overwrites the data
+int TwoWire::slaveAvailable()
+{
+  return slaveRxBufferLength - slaveRxBufferIndex;
+}
+
+int TwoWire::slaveRead()
+{
+  int value = -1;
+
+  if (slaveRxBufferIndex < slaveRxBufferLength)
+  {
+    value = slaveRxBuffer[slaveRxBufferIndex];
+    slaveRxBufferIndex++;
+  }
+  return value;
+}
+
+int TwoWire::slavePeek()
+{
+  int value = -1;
+
+  if (slaveRxBufferIndex < slaveRxBufferLength)
+  {
+    value = slaveRxBuffer[slaveRxBufferIndex];
+  }
+  return value;
+}
+
 // can be used to get out of an error state in TWI module
 // e.g. when MDATA regsiter is written before MADDR
 void TwoWire::flush()
@@ -362,6 +490,93 @@ void TwoWire::flush()
   //   TWI_Flush();
 }
 
+bool TwoWire::writeAsync(TWI_Transaction_t *transaction, uint8_t address, const uint8_t *data, uint16_t quantity,
+                         void (*callback)(TWI_Transaction_t *))
+{
+  return writeReadAsync(transaction, address, data, quantity, NULL, 0, callback);
+}
+
+bool TwoWire::readAsync(TWI_Transaction_t *transaction, uint8_t address, uint8_t *data, uint16_t quantity,
+                        void (*callback)(TWI_Transaction_t *))
+{
+  return writeReadAsync(transaction, address, NULL, 0, data, quantity, callback);
+}
+
+// Writes first, then reads after a repeated start, like a register read
+bool TwoWire::writeReadAsync(TWI_Transaction_t *transaction, uint8_t address, const uint8_t *writeData, uint16_t writeQuantity,
+                             uint8_t *readData, uint16_t readQuantity, void (*callback)(TWI_Transaction_t *))
+{
+  transaction->slave_address = address;
+  transaction->write_data = writeData;
+  transaction->bytes_to_write = writeQuantity;
+  transaction->read_data = readData;
+  transaction->bytes_to_read = readQuantity;
+  transaction->send_stop = true;
+  transaction->callback = callback;
+
+  return TWI_MasterQueue(transaction);
+}
+
+bool TwoWire::done(TWI_Transaction_t *transaction)
+{
+  TWI_MasterPoll();
+  return transaction->result != TWIM_RESULT_UNKNOWN;
+}
+
+// Blocks until the transaction is done. Returns the same status codes as endTransmission()
+uint8_t TwoWire::wait(TWI_Transaction_t *transaction)
+{
+  while (transaction->result == TWIM_RESULT_UNKNOWN)
+  {
+    TWI_MasterPoll();
+  }
+  return TWI_MasterResultStatus(transaction->result);
+}
+
+// Writes the register address, then reads quantity bytes straight into
+// buffer after a repeated start. Returns the number of bytes read
+size_t TwoWire::readInto(uint8_t address, uint8_t reg, uint8_t *buffer, size_t quantity)
+{
+  TWI_Transaction_t transaction;
+  writeReadAsync(&transaction, address, &reg, 1, buffer, quantity);
+  wait(&transaction);
+  return transaction.bytes_read;
+}
+
+size_t TwoWire::readInto(uint8_t address, uint8_t *buffer, size_t quantity)
+{
+  TWI_Transaction_t transaction;
+  readAsync(&transaction, address, buffer, quantity);
+  wait(&transaction);
+  return transaction.bytes_read;
+}
+
+// Returns the same status codes as endTransmission()
+uint8_t TwoWire::writeFrom(uint8_t address, const uint8_t *buffer, size_t quantity)
+{
+  TWI_Transaction_t transaction;
+  writeAsync(&transaction, address, buffer, quantity);
+  return wait(&transaction);
+}
+
+// Serves map->address from the map. The address must be one the slave
+// answers to, set with begin(address, receive_broadcast, second_address)
+bool TwoWire::addRegisterMap(TWI_RegisterMap_t *map)
+{
+  return TWI_SlaveAddRegisterMap(map);
+}
+
+void TwoWire::removeRegisterMap(uint8_t address)
+{
+  TWI_SlaveRemoveRegisterMap(address);
+}
+
+// Returns the address the master used, for slaves that answer to more than one
+uint8_t TwoWire::getIncomingAddress()
+{
+  return TWI_SlaveMatchedAddress();
+}
+
 // behind the scenes function that is called when data is received
 void TwoWire::onReceiveService(int numBytes)
 {
@@ -370,20 +585,14 @@ void TwoWire::onReceiveService(int numBytes)
   {
     return;
   }
-  // don't bother if rx buffer is in use by a master requestFrom() op
-  // i know this drops data, but it allows for slight stupidity
-  // meaning, they may not have read all the master requestFrom() data yet
-  if (rxBufferIndex < rxBufferLength)
-  {
-    return;
-  }
-
   // set rx iterator vars
-  rxBufferIndex = 0;
-  rxBufferLength = numBytes;
+  slaveRxBufferIndex = 0;
+  slaveRxBufferLength = numBytes;
 
   // alert user program
+  slaveCallback = 1;
   user_onReceive(numBytes);
+  slaveCallback = 0;
 }
 
 // behind the scenes function that is called when data is requested
@@ -396,13 +605,14 @@ uint8_t TwoWire::onRequestService()
   }
 
   // reset slave write buffer iterator var
-  txBufferIndex = 0;
-  txBufferLength = 0;
+  slaveTxBufferLength = 0;
 
   // alert user program
+  slaveCallback = 1;
   user_onRequest();
+  slaveCallback = 0;
 
-  return txBufferLength;
+  return slaveTxBufferLength;
 }
 
 // sets function called on slave write
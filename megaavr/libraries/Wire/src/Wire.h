@@ -24,6 +24,11 @@
 
 #include <Arduino.h>
 
+extern "C"
+{
+#include "utility/twi.h"
+}
+
 #ifndef TWI_BUFFER_SIZE
 #if ((RAMEND - RAMSTART) < 1023)
 #define TWI_BUFFER_SIZE 16
@@ -38,6 +43,10 @@
 
 // WIRE_HAS_END means Wire has end()
 #define WIRE_HAS_END 1
+
+// WIRE_HAS_TIMEOUT means Wire has setWireTimeout(), getWireTimeoutFlag
+// and clearWireTimeoutFlag()
+#define WIRE_HAS_TIMEOUT 1
 class TwoWire : public Stream
 {
   private:
@@ -50,6 +59,16 @@ class TwoWire : public Stream
     static uint8_t txBufferIndex;
     static uint8_t txBufferLength;
 
+    // The slave has its own buffers, so it can run alongside the master
+    static uint8_t slaveRxBuffer[];
+    static uint8_t slaveRxBufferIndex;
+    static uint8_t slaveRxBufferLength;
+    static uint8_t slaveTxBuffer[];
+    static uint8_t slaveTxBufferLength;
+    static uint8_t slaveCallback;
+    static uint8_t masterEnabled;
+    static bool useSlaveBuffers();
+
     static uint8_t transmitting;
     static void (*user_onRequest)();
     static void (*user_onReceive)(int);
@@ -68,7 +87,14 @@ class TwoWire : public Stream
     void begin(uint8_t address, bool receive_broadcast);
     void begin(int address, bool receive_broadcast);
     void end();
+    void enableDualMode(bool fmp_enable = false);
     void setClock(uint32_t frequency);
+    void setRiseTime(uint16_t riseTime);
+    void setBusCapacitance(uint16_t capacitance, uint16_t pullup);
+    void setWireTimeout(uint32_t timeout = 25000, bool reset_with_timeout = false);
+    bool getWireTimeoutFlag(void);
+    void clearWireTimeoutFlag(void);
+    void recoverBus(void);
     void beginTransmission(uint8_t address);
     void beginTransmission(int address);
     uint8_t endTransmission();
@@ -87,6 +113,33 @@ class TwoWire : public Stream
     virtual void flush();
     void onReceive(void (*)(int));
     void onRequest(void (*)(void));
+    int slaveAvailable();
+    int slaveRead();
+    int slavePeek();
+
+    // Non-blocking transactions, queued and run from the TWI interrupt.
+    // The transaction and its buffers are owned by the caller, and must be
+    // left alone until done() returns true or the callback is called
+    bool writeAsync(TWI_Transaction_t *transaction, uint8_t address, const uint8_t *data, uint16_t quantity,
+                    void (*callback)(TWI_Transaction_t *) = NULL);
+    bool readAsync(TWI_Transaction_t *transaction, uint8_t address, uint8_t *data, uint16_t quantity,
+                   void (*callback)(TWI_Transaction_t *) = NULL);
+    bool writeReadAsync(TWI_Transaction_t *transaction, uint8_t address, const uint8_t *writeData, uint16_t writeQuantity,
+                        uint8_t *readData, uint16_t readQuantity, void (*callback)(TWI_Transaction_t *) = NULL);
+    bool done(TWI_Transaction_t *transaction);
+    uint8_t wait(TWI_Transaction_t *transaction);
+
+    // Blocking transfers straight to and from the caller's buffer, without
+    // going through the Wire buffers or their size limit
+    size_t readInto(uint8_t address, uint8_t reg, uint8_t *buffer, size_t quantity);
+    size_t readInto(uint8_t address, uint8_t *buffer, size_t quantity);
+    uint8_t writeFrom(uint8_t address, const uint8_t *buffer, size_t quantity);
+
+    // Slave addresses served from a register map entirely in the TWI
+    // interrupt, without calling onReceive() or onRequest()
+    bool addRegisterMap(TWI_RegisterMap_t *map);
+    void removeRegisterMap(uint8_t address);
+    uint8_t getIncomingAddress();
 
     inline size_t write(unsigned long data) { return write((uint8_t)data); }
     inline size_t write(long data) { return write((uint8_t)data); }
@@ -24,16 +24,15 @@
 #include "Arduino.h"
 
 /* Master variables */
-static register8_t master_slaveAddress; /*!< Slave address */
-static register8_t* master_writeData;   /*!< Data to write */
-static register8_t* master_readData;    /*!< Read data */
-static register8_t master_bytesToWrite; /*!< Number of bytes to write */
-static register8_t master_bytesToRead;  /*!< Number of bytes to read */
-static register8_t master_bytesWritten; /*!< Number of bytes written */
-static register8_t master_bytesRead;    /*!< Number of bytes read */
-static register8_t master_sendStop;     /*!< To send a stop at the end of the transaction or not */
-static register8_t master_trans_status; /*!< Status of transaction */
-static register8_t master_result;       /*!< Result of transaction */
+static TWI_Transaction_t* volatile master_queueHead; /*!< Transaction in progress */
+static TWI_Transaction_t* volatile master_queueTail; /*!< Last queued transaction */
+static uint32_t master_timeout_us;                  /*!< Longest time without bus progress, 0 to wait forever */
+static uint8_t master_resetWithTimeout;             /*!< Recover the bus when a timeout occurs */
+static volatile uint8_t master_timeoutFlag;         /*!< Set when a timeout has occurred */
+static volatile uint32_t master_lastProgress;       /*!< micros() of the last bus progress */
+static volatile uint8_t master_recoverPending;      /*!< Bus recovery left for the next TWI_MasterPoll() outside an interrupt */
+static uint32_t master_frequency = 100000;          /*!< SCL frequency */
+static uint16_t master_riseTime_ns;                 /*!< SCL rise time, 0 to use the I2C specification maximum */
 
 /* Slave variables */
 static uint8_t (*TWI_onSlaveTransmit)(void) __attribute__((unused));
@@ -48,9 +47,20 @@ static register8_t slave_trans_status;
 static register8_t slave_result;
 static register8_t slave_callUserReceive;
 static register8_t slave_callUserRequest;
+static register8_t slave_matchedAddress;
+static TWI_RegisterMap_t* slave_maps[TWI_SLAVE_REGISTER_MAPS];
+static TWI_RegisterMap_t* volatile slave_map;   /*!< Register map serving the current transaction, or NULL */
+static register8_t slave_mapPointerPending;      /*!< Next byte written by the master sets the register pointer */
+static void TWI_SlaveMapWriteHandler(void);
+static void TWI_SlaveMapReadHandler(void);
 
-/* TWI module mode */
+static void TWI_MasterStart(void);
+
+/* TWI module mode. The master and the slave run independently of each
+ * other, either on the same bus or on separate pins in dual mode */
 static volatile TWI_MODE_t twi_mode;
+static volatile TWI_MODE_t twi_slave_mode;
+static uint8_t twi_dual_ctrl;
 
 /*! \brief Initialize the TWI module as a master.
  *
@@ -89,16 +99,142 @@ void TWI_MasterInit(uint32_t frequency)
 
   twi_mode = TWI_MODE_MASTER;
 
-  master_bytesRead = 0;
-  master_bytesWritten = 0;
-  master_trans_status = TWIM_STATUS_READY;
-  master_result = TWIM_RESULT_UNKNOWN;
+  master_queueHead = NULL;
+  master_queueTail = NULL;
 
-  TWI0.MCTRLA = TWI_RIEN_bm | TWI_WIEN_bm | TWI_ENABLE_bm;
+  TWI0.MCTRLA = TWI_RIEN_bm | TWI_WIEN_bm | TWI_ENABLE_bm | (master_timeout_us ? TWI_TIMEOUT_200US_gc : TWI_TIMEOUT_DISABLED_gc);
   TWI_MasterSetBaud(frequency);
   TWI0.MSTATUS = TWI_BUSSTATE_IDLE_gc;
 }
 
+/*! \brief Set the master transaction timeout.
+ *
+ *  A transaction fails with TWIM_RESULT_TIMEOUT if the bus makes no progress
+ *  for the given time. The bus state timeout of the TWI is enabled as well,
+ *  so a bus left busy by a vanished master is seen as idle again. The
+ *  timeout is checked by TWI_MasterPoll(), which every blocking function,
+ *  TWI_MasterQueue() and the done/wait functions of the Wire library call.
+ *
+ *  \param timeout_us          Timeout in microseconds, 0 to wait forever.
+ *  \param reset_with_timeout  Recover the bus with TWI_MasterRecoverBus()
+ *                             after a timeout.
+ */
+void TWI_MasterSetTimeout(uint32_t timeout_us, uint8_t reset_with_timeout)
+{
+  uint8_t status = SREG;
+  cli();
+  master_timeout_us = timeout_us;
+  master_resetWithTimeout = reset_with_timeout;
+  // Progress isn't tracked while there's no timeout
+  master_lastProgress = micros();
+  SREG = status;
+
+  if (TWI0.MCTRLA & TWI_ENABLE_bm)
+  {
+    TWI0.MCTRLA = (TWI0.MCTRLA & ~TWI_TIMEOUT_gm) | (timeout_us ? TWI_TIMEOUT_200US_gc : TWI_TIMEOUT_DISABLED_gc);
+  }
+}
+
+uint8_t TWI_MasterTimeoutFlag(void)
+{
+  return master_timeoutFlag;
+}
+
+void TWI_MasterClearTimeoutFlag(void)
+{
+  master_timeoutFlag = 0;
+}
+
+/*! \brief Check the transaction in progress for a timeout.
+ *
+ *  Called by the blocking functions while they wait, and by TWI_MasterQueue()
+ *  and the Wire library done/wait functions. On timeout, the transaction is
+ *  finished with TWIM_RESULT_TIMEOUT and the next one in the queue is
+ *  started. A bus recovery takes about 100us, so it's never run from an
+ *  interrupt. The queue is held until a call from outside an interrupt has
+ *  recovered the bus.
+ */
+void TWI_MasterPoll(void)
+{
+  if (master_timeout_us == 0)
+    return;
+
+  uint8_t status = SREG;
+  cli();
+  if (master_queueHead != NULL && !master_recoverPending && (micros() - master_lastProgress) > master_timeout_us)
+  {
+    master_timeoutFlag = 1;
+    if (master_resetWithTimeout)
+    {
+      master_recoverPending = 1;
+    }
+    else
+    {
+      TWI0.MCTRLB = TWI_MCMD_STOP_gc;
+    }
+    TWI_MasterTransactionFinished(TWIM_RESULT_TIMEOUT);
+  }
+  SREG = status;
+
+  if (master_recoverPending && !(CPUINT.STATUS & (CPUINT_LVL0EX_bm | CPUINT_LVL1EX_bm)))
+  {
+    TWI_MasterRecoverBus();
+
+    cli();
+    master_recoverPending = 0;
+    if (master_queueHead != NULL)
+    {
+      TWI_MasterStart();
+    }
+    SREG = status;
+  }
+}
+
+/*! \brief Recover a bus held low by a slave.
+ *
+ *  Takes SDA and SCL from the TWI, clocks out nine SCL pulses so a slave
+ *  stuck in the middle of a byte finishes it and lets go of SDA, and then
+ *  sends a STOP condition. The TWI is enabled again afterwards with the
+ *  bus state forced to idle.
+ */
+void TWI_MasterRecoverBus(void)
+{
+  uint8_t sda = PIN_WIRE_SDA;
+  uint8_t scl = PIN_WIRE_SCL;
+#if defined(PIN_WIRE_SDA_PINSWAP_1) && defined(PIN_WIRE_SCL_PINSWAP_1)
+  if ((PORTMUX.TWISPIROUTEA & 0x30) == TWI_MUX_PINSWAP)
+  {
+    sda = PIN_WIRE_SDA_PINSWAP_1;
+    scl = PIN_WIRE_SCL_PINSWAP_1;
+  }
+#endif
+
+  uint8_t mctrla = TWI0.MCTRLA;
+  TWI0.MCTRLA = 0;
+
+  // The pins are driven open drain, low as an output and high as an input with pullup
+  pinMode(sda, INPUT_PULLUP);
+  for (uint8_t i = 0; i < 9; i++)
+  {
+    pinMode(scl, OUTPUT);
+    digitalWrite(scl, LOW);
+    delayMicroseconds(5);
+    pinMode(scl, INPUT_PULLUP);
+    delayMicroseconds(5);
+  }
+
+  // STOP condition, SDA going high while SCL is high
+  pinMode(sda, OUTPUT);
+  digitalWrite(sda, LOW);
+  delayMicroseconds(5);
+  pinMode(sda, INPUT_PULLUP);
+  delayMicroseconds(5);
+
+  TWI0.MCTRLA = mctrla;
+  TWI0.MCTRLB = TWI_FLUSH_bm;
+  TWI0.MSTATUS = TWI_BUSSTATE_IDLE_gc;
+}
+
 /*! \brief Initialize the TWI module as a slave.
  *
  *  TWI slave initialization function.
@@ -110,7 +246,7 @@ void TWI_MasterInit(uint32_t frequency)
  */
 void TWI_SlaveInit(uint8_t address, uint8_t receive_broadcast, uint8_t second_address)
 {
-  if (twi_mode != TWI_MODE_UNKNOWN)
+  if (twi_slave_mode != TWI_MODE_UNKNOWN)
     return;
 
   // Disable pins hardwired to the default i2c pins (PA2 and PA3)
@@ -123,7 +259,26 @@ void TWI_SlaveInit(uint8_t address, uint8_t receive_broadcast, uint8_t second_ad
   }
 #endif
 
-  twi_mode = TWI_MODE_SLAVE;
+  /* In dual mode the slave has its own pins, PC2/PC3 with the default
+   * master pins and PF2/PF3 otherwise */
+  if (twi_dual_ctrl)
+  {
+    if ((PORTMUX.TWISPIROUTEA & 0x30) == PORTMUX_TWI0_DEFAULT_gc)
+    {
+      pinMode(PIN_PC2, INPUT_PULLUP);
+      pinMode(PIN_PC3, INPUT_PULLUP);
+    }
+#if defined(PIN_PF2) && defined(PIN_PF3)
+    else
+    {
+      pinMode(PIN_PF2, INPUT_PULLUP);
+      pinMode(PIN_PF3, INPUT_PULLUP);
+    }
+#endif
+    TWI0.DUALCTRL = twi_dual_ctrl;
+  }
+
+  twi_slave_mode = TWI_MODE_SLAVE;
 
   slave_bytesRead = 0;
   slave_bytesWritten = 0;
@@ -136,8 +291,23 @@ void TWI_SlaveInit(uint8_t address, uint8_t receive_broadcast, uint8_t second_ad
   TWI0.SADDRMASK = second_address;
   TWI0.SCTRLA = TWI_DIEN_bm | TWI_APIEN_bm | TWI_PIEN_bm | TWI_ENABLE_bm;
 
-  /* Bus Error Detection circuitry needs Master enabled to work */
-  TWI0.MCTRLA = TWI_ENABLE_bm;
+  /* Bus Error Detection circuitry needs Master enabled to work,
+   * which it already is if the master is running */
+  if (twi_mode == TWI_MODE_UNKNOWN)
+    TWI0.MCTRLA = TWI_ENABLE_bm;
+}
+
+/*! \brief Let the slave use its own pins.
+ *
+ *  Must be called before TWI_SlaveInit(). The master keeps the pins selected
+ *  by PORTMUX, while the slave moves to the dual mode pins, so each can be
+ *  connected to a separate bus.
+ *
+ *  \param fmp_enable  Enable Fast-mode Plus on the slave pins.
+ */
+void TWI_EnableDualMode(uint8_t fmp_enable)
+{
+  twi_dual_ctrl = TWI_ENABLE_bm | TWI_SDAHOLD_300NS_gc | (fmp_enable ? TWI_FMPEN_bm : 0);
 }
 
 void TWI_Flush(void)
@@ -159,7 +329,25 @@ void TWI_Disable(void)
   TWI0.SADDR = 0x00;
   TWI0.SCTRLA = 0x00;
   TWI0.SADDRMASK = 0;
+  TWI0.DUALCTRL = 0x00;
   twi_mode = TWI_MODE_UNKNOWN;
+  twi_slave_mode = TWI_MODE_UNKNOWN;
+  twi_dual_ctrl = 0;
+
+  /* Fail whatever is still queued, so nobody waits forever */
+  uint8_t status = SREG;
+  cli();
+  while (master_queueHead != NULL)
+  {
+    TWI_Transaction_t* transaction = master_queueHead;
+    master_queueHead = transaction->next;
+    transaction->result = TWIM_RESULT_FAIL;
+    if (transaction->callback != NULL)
+    {
+      transaction->callback(transaction);
+    }
+  }
+  SREG = status;
 }
 
 /*! \brief Returns the TWI bus state.
@@ -193,47 +381,76 @@ TWI_BUSSTATE_t TWI_MasterState(void)
  */
 uint8_t TWI_MasterReady(void)
 {
-  uint8_t twi_status = (master_trans_status & TWIM_STATUS_READY);
-  return twi_status;
+  return (master_queueHead == NULL);
+}
+
+/*! \brief Set the SCL rise time used for the baud rate calculation.
+ *
+ *  The rise time depends on the bus capacitance and the pull-up resistors,
+ *  T_RISE = 0.8473 * R_PULLUP * C_BUS. The actual SCL frequency is lower than
+ *  requested by the rise time, so knowing it makes the baud rate exact.
+ *
+ *  \param rise_time_ns  SCL rise time in nanoseconds, 0 to use the maximum
+ *                       rise time allowed by the I2C specification for the
+ *                       chosen frequency.
+ */
+void TWI_MasterSetRiseTime(uint16_t rise_time_ns)
+{
+  master_riseTime_ns = rise_time_ns;
+  TWI_MasterSetBaud(master_frequency);
 }
 
 /*! \brief Set the TWI baud rate.
  *
- *  Sets the baud rate used by TWI Master.
+ *  Sets the baud rate used by TWI Master, and the bus timing options that
+ *  go with it. Fast-mode Plus is enabled above 400kHz.
  *
- *  \param frequency            The required baud.
+ *  \param frequency            The required baud, up to 1MHz.
  */
 void TWI_MasterSetBaud(uint32_t frequency)
 {
   // Formula is: BAUD = ((F_CLKPER/frequency) - F_CLKPER*T_RISE - 10)/2;
-  // Where T_RISE varies depending on operating frequency...
-  // From 1617 DS: 1000ns @ 100kHz / 300ns @ 400kHz / 120ns @ 1MHz
+  // Where T_RISE is the maximum allowed by the I2C specification unless set:
+  // 1000ns @ 100kHz / 300ns @ 400kHz / 120ns @ 1MHz
 
-  uint16_t t_rise;
-  uint16_t freq_khz = frequency / 1000;
+  if (frequency == 0)
+    frequency = 100000;
+  else if (frequency > 1000000)
+    frequency = 1000000;
+  master_frequency = frequency;
 
-  if (freq_khz < 200)
-  {
-    freq_khz = 100;
-    t_rise = 1000;
-  }
-  else if (freq_khz < 800)
+  uint16_t t_rise = master_riseTime_ns;
+  uint8_t ctrla;
+
+  if (frequency <= 100000)
   {
-    freq_khz = 400;
-    t_rise = 300;
+    // Standard mode, 250ns data setup time
+    if (t_rise == 0)
+      t_rise = 1000;
+    ctrla = TWI_SDASETUP_8CYC_gc | TWI_SDAHOLD_300NS_gc;
   }
-  else if (freq_khz < 1200)
+  else if (frequency <= 400000)
   {
-    freq_khz = 1000;
-    t_rise = 120;
+    // Fast mode, 100ns data setup time
+    if (t_rise == 0)
+      t_rise = 300;
+    ctrla = TWI_SDASETUP_4CYC_gc | TWI_SDAHOLD_300NS_gc;
   }
   else
   {
-    freq_khz = 100;
-    t_rise = 1000;
+    // Fast-mode Plus, 50ns data setup time and no more than 450ns until data is valid
+    if (t_rise == 0)
+      t_rise = 120;
+    ctrla = TWI_SDASETUP_4CYC_gc | TWI_SDAHOLD_50NS_gc | TWI_FMPEN_bm;
   }
 
-  uint32_t baud = ((F_CPU / 1000 / freq_khz) - (((F_CPU * t_rise) / 1000) / 1000) / 1000 - 10) / 2;
+  int32_t baud = ((int32_t)(F_CPU / frequency) - (int32_t)(((F_CPU / 1000) * t_rise) / 1000000) - 10) / 2;
+  if (baud < 0)
+    baud = 0;
+  else if (baud > 255)
+    baud = 255;
+
+  TWI0.CTRLA = ctrla;
   TWI0.MBAUD = (uint8_t)baud;
 }
 
@@ -258,6 +475,7 @@ uint8_t TWI_MasterWrite(uint8_t slave_address,
                              write_data,
                              bytes_to_write,
                              0,
+                             0,
                              send_stop);
 }
 
@@ -265,125 +483,179 @@ uint8_t TWI_MasterWrite(uint8_t slave_address,
  *
  *  This function is a TWI Master wrapper for read-only transaction.
  *
- *  \param twi            The TWI_Master_t struct instance.
  *  \param address        The slave address.
+ *  \param read_data      Buffer for the read data.
  *  \param bytesToRead    The number of bytes to read.
  *
- *  \retval true  If transaction could be started.
- *  \retval false If transaction could not be started.
+ *  \retval The number of bytes read.
  */
 uint8_t TWI_MasterRead(uint8_t slave_address,
                        uint8_t* read_data,
                        uint8_t bytes_to_read,
                        uint8_t send_stop)
 {
-  master_readData = read_data;
-
-  uint8_t bytes_read = TWI_MasterWriteRead(slave_address,
-                                           0,
-                                           0,
-                                           bytes_to_read,
-                                           send_stop);
-  return bytes_read;
+  return TWI_MasterWriteRead(slave_address,
+                             0,
+                             0,
+                             read_data,
+                             bytes_to_read,
+                             send_stop);
 }
 
 /*! \brief TWI write and/or read transaction.
  *
  *  This function is a TWI Master write and/or read transaction. The function
  *  can be used to both write and/or read bytes to/from the TWI Slave in one
- *  transaction.
+ *  transaction. It queues the transaction and waits for it to finish.
  *
- *  \param twi            The TWI_Master_t struct instance.
  *  \param address        The slave address.
  *  \param writeData      Pointer to data to write.
  *  \param bytesToWrite   Number of bytes to write.
+ *  \param readData       Buffer for the read data.
  *  \param bytesToRead    Number of bytes to read.
  *
- *  \retval true  If transaction could be started.
- *  \retval false If transaction could not be started.
+ *  \retval The number of bytes read if reading, otherwise a status code
+ *          from TWI_MasterResultStatus().
  */
 uint8_t TWI_MasterWriteRead(uint8_t slave_address,
                             uint8_t* write_data,
                             uint8_t bytes_to_write,
+                            uint8_t* read_data,
                             uint8_t bytes_to_read,
                             uint8_t send_stop)
 {
-  if (twi_mode != TWI_MODE_MASTER)
-    return false;
+  TWI_Transaction_t transaction;
+  transaction.slave_address = slave_address;
+  transaction.write_data = write_data;
+  transaction.bytes_to_write = bytes_to_write;
+  transaction.read_data = read_data;
+  transaction.bytes_to_read = bytes_to_read;
+  transaction.send_stop = send_stop;
+  transaction.callback = NULL;
+
+  if (!TWI_MasterQueue(&transaction))
+  {
+    return (bytes_to_read > 0) ? 0 : 1;
+  }
 
-  /*Initiate transaction if bus is ready. */
-  if (master_trans_status == TWIM_STATUS_READY)
+  /* Arduino requires blocking function */
+  while (transaction.result == TWIM_RESULT_UNKNOWN)
   {
-    master_trans_status = TWIM_STATUS_BUSY;
-    master_result = TWIM_RESULT_UNKNOWN;
+    TWI_MasterPoll();
+  }
 
-    master_writeData = write_data;
+  if (bytes_to_read > 0)
+  {
+    // return bytes really read
+    return transaction.bytes_read;
+  }
+  return TWI_MasterResultStatus(transaction.result);
+}
 
-    master_bytesToWrite = bytes_to_write;
-    master_bytesToRead = bytes_to_read;
-    master_bytesWritten = 0;
-    master_bytesRead = 0;
-    master_sendStop = send_stop;
-    master_slaveAddress = slave_address << 1;
+/*! \brief Convert a transaction result to a status code.
+ *
+ *  \param result  TWIM_RESULT_t of a finished transaction.
+ *
+ *  \retval TWI_STATUS_OK, TWI_STATUS_ADDRESS_NACK, TWI_STATUS_DATA_NACK,
+ *          TWI_STATUS_TIMEOUT or TWI_STATUS_OTHER_ERROR.
+ */
+uint8_t TWI_MasterResultStatus(uint8_t result)
+{
+  switch (result)
+  {
+    case TWIM_RESULT_OK:
+      return TWI_STATUS_OK;
+    case TWIM_RESULT_ADDRESS_NACK:
+      return TWI_STATUS_ADDRESS_NACK;
+    case TWIM_RESULT_NACK_RECEIVED:
+      return TWI_STATUS_DATA_NACK;
+    case TWIM_RESULT_TIMEOUT:
+      return TWI_STATUS_TIMEOUT;
+    default:
+      return TWI_STATUS_OTHER_ERROR;
+  }
+}
 
-  trigger_action:
+/*! \brief Start the transaction at the head of the queue.
+ *
+ *  Sends the START condition + Address + 'R/_W = 0' if there is anything
+ *  to write, or if there is nothing to read either. Otherwise the START
+ *  condition + Address + 'R/_W = 1'.
+ */
+static void TWI_MasterStart(void)
+{
+  TWI_Transaction_t* transaction = master_queueHead;
+  uint8_t slaveAddress = transaction->slave_address << 1;
 
-    /* If write command, send the START condition + Address +
-     * 'R/_W = 0'
-     */
-    if (master_bytesToWrite > 0)
-    {
-      twi_mode = TWI_MODE_MASTER_TRANSMIT;
-      uint8_t writeAddress = ADD_WRITE_BIT(master_slaveAddress);
-      TWI0.MADDR = writeAddress;
-    }
+  transaction->bytes_written = 0;
+  transaction->bytes_read = 0;
+  if (master_timeout_us)
+  {
+    master_lastProgress = micros();
+  }
 
-    /* If read command, send the START condition + Address +
-     * 'R/_W = 1'
-     */
-    else if (master_bytesToRead > 0)
-    {
-      twi_mode = TWI_MODE_MASTER_RECEIVE;
-      uint8_t readAddress = ADD_READ_BIT(master_slaveAddress);
-      TWI0.MADDR = readAddress;
-    }
+  if (transaction->bytes_to_write > 0 || transaction->bytes_to_read == 0)
+  {
+    twi_mode = TWI_MODE_MASTER_TRANSMIT;
+    TWI0.MADDR = ADD_WRITE_BIT(slaveAddress);
+  }
+  else
+  {
+    twi_mode = TWI_MODE_MASTER_RECEIVE;
+    TWI0.MADDR = ADD_READ_BIT(slaveAddress);
+  }
+}
 
-    else if (master_bytesToWrite == 0 && master_bytesToRead == 0)
-    {
-      twi_mode = TWI_MODE_MASTER_TRANSMIT;
-      uint8_t writeAddress = ADD_WRITE_BIT(master_slaveAddress);
-      TWI0.MADDR = writeAddress;
-    }
+/*! \brief Queue a TWI transaction.
+ *
+ *  Adds the transaction to the end of the queue and returns right away.
+ *  The transaction is started as soon as the ones before it are done.
+ *  A transaction must not be queued again before it's finished.
+ *
+ *  \param transaction    The transaction, owned by the caller.
+ *
+ *  \retval true  If the transaction was queued.
+ *  \retval false If the TWI is not initialized as a master. The result
+ *                is set to TWIM_RESULT_FAIL.
+ */
+uint8_t TWI_MasterQueue(TWI_Transaction_t* transaction)
+{
+  /* Don't queue behind a transaction that has already timed out */
+  TWI_MasterPoll();
 
-    /* Arduino requires blocking function */
-    while (master_result == TWIM_RESULT_UNKNOWN)
-    {
-    }
+  transaction->bytes_written = 0;
+  transaction->bytes_read = 0;
 
-    // in case of arbitration lost, retry sending
-    if (master_result == TWIM_RESULT_ARBITRATION_LOST)
-    {
-      goto trigger_action;
-    }
+  TWI_MODE_t mode = twi_mode;
+  if (mode != TWI_MODE_MASTER && mode != TWI_MODE_MASTER_TRANSMIT && mode != TWI_MODE_MASTER_RECEIVE)
+  {
+    transaction->result = TWIM_RESULT_FAIL;
+    return false;
+  }
 
-    uint8_t ret = 0;
-    if (master_bytesToRead > 0)
-    {
-      // return bytes really read
-      ret = master_bytesRead;
-    }
-    else
+  transaction->result = TWIM_RESULT_UNKNOWN;
+  transaction->retries = 0;
+  transaction->next = NULL;
+
+  uint8_t status = SREG;
+  cli();
+  if (master_queueHead == NULL)
+  {
+    master_queueHead = transaction;
+    master_queueTail = transaction;
+    if (!master_recoverPending)
     {
-      // return 0 if success, 1 otherwise
-      ret = (master_result == TWIM_RESULT_OK ? 0 : 1);
+      TWI_MasterStart();
     }
-
-    return ret;
   }
   else
   {
-    return 1;
+    master_queueTail->next = transaction;
+    master_queueTail = transaction;
   }
+  SREG = status;
+
+  return true;
 }
 
 /*! \brief Common TWI master interrupt service routine.
@@ -395,6 +667,19 @@ void TWI_MasterInterruptHandler()
 {
   uint8_t currentStatus = TWI0.MSTATUS;
 
+  /* Nothing to do without a transaction, or while the queue is held for a
+   * bus recovery, just clear the flags */
+  if (master_queueHead == NULL || master_recoverPending)
+  {
+    TWI0.MSTATUS = currentStatus;
+    return;
+  }
+
+  if (master_timeout_us)
+  {
+    master_lastProgress = micros();
+  }
+
   /* If arbitration lost or bus error. */
   if ((currentStatus & TWI_ARBLOST_bm) ||
       (currentStatus & TWI_BUSERR_bm))
@@ -430,23 +715,24 @@ void TWI_MasterArbitrationLostBusErrorHandler()
 {
   uint8_t currentStatus = TWI0.MSTATUS;
 
+  /* Clear all flags, abort operation */
+  TWI0.MSTATUS = currentStatus;
+
   /* If bus error. */
   if (currentStatus & TWI_BUSERR_bm)
   {
-    master_result = TWIM_RESULT_BUS_ERROR;
+    TWI_MasterTransactionFinished(TWIM_RESULT_BUS_ERROR);
+  }
+  /* If arbitration lost, retry sending a few times */
+  else if (master_queueHead->retries < TWI_ARBITRATION_RETRIES)
+  {
+    master_queueHead->retries++;
+    TWI_MasterStart();
   }
-  /* If arbitration lost. */
   else
   {
-    master_result = TWIM_RESULT_ARBITRATION_LOST;
+    TWI_MasterTransactionFinished(TWIM_RESULT_ARBITRATION_LOST);
   }
-
-  /* Clear all flags, abort operation */
-  TWI0.MSTATUS = currentStatus;
-
-  /* Wait for a new operation */
-  twi_mode = TWI_MODE_MASTER;
-  master_trans_status = TWIM_STATUS_READY;
 }
 
 /*! \brief TWI master write interrupt handler.
@@ -456,14 +742,12 @@ void TWI_MasterArbitrationLostBusErrorHandler()
  */
 void TWI_MasterWriteHandler()
 {
-  /* Local variables used in if tests to avoid compiler warning. */
-  uint8_t bytesToWrite = master_bytesToWrite;
-  uint8_t bytesToRead = master_bytesToRead;
+  TWI_Transaction_t* transaction = master_queueHead;
 
   /* If NOT acknowledged (NACK) by slave cancel the transaction. */
   if (TWI0.MSTATUS & TWI_RXACK_bm)
   {
-    if (master_sendStop)
+    if (transaction->send_stop)
     {
       TWI0.MCTRLB = TWI_MCMD_STOP_gc;
     }
@@ -471,31 +755,40 @@ void TWI_MasterWriteHandler()
     {
       TWI0.MCTRLB = TWI_MCMD_REPSTART_gc;
     }
-    TWI_MasterTransactionFinished(TWIM_RESULT_NACK_RECEIVED);
+
+    /* Tell a missing slave from one refusing data */
+    if (transaction->bytes_written == 0 || twi_mode == TWI_MODE_MASTER_RECEIVE)
+    {
+      TWI_MasterTransactionFinished(TWIM_RESULT_ADDRESS_NACK);
+    }
+    else
+    {
+      TWI_MasterTransactionFinished(TWIM_RESULT_NACK_RECEIVED);
+    }
   }
 
   /* If more bytes to write, send data. */
-  else if (master_bytesWritten < bytesToWrite)
+  else if (transaction->bytes_written < transaction->bytes_to_write)
   {
-    uint8_t data = master_writeData[master_bytesWritten];
+    uint8_t data = transaction->write_data[transaction->bytes_written];
     TWI0.MDATA = data;
-    master_bytesWritten++;
+    transaction->bytes_written++;
   }
 
   /* If bytes to read, send START condition + Address +
    * 'R/_W = 1'
    */
-  else if (master_bytesRead < bytesToRead)
+  else if (transaction->bytes_read < transaction->bytes_to_read)
   {
     twi_mode = TWI_MODE_MASTER_RECEIVE;
-    uint8_t readAddress = ADD_READ_BIT(master_slaveAddress);
+    uint8_t readAddress = ADD_READ_BIT(transaction->slave_address << 1);
     TWI0.MADDR = readAddress;
   }
 
   /* If transaction finished, send ACK/STOP condition if instructed and set RESULT OK. */
   else
   {
-    if (master_sendStop)
+    if (transaction->send_stop)
     {
       TWI0.MCTRLB = TWI_MCMD_STOP_gc;
     }
@@ -516,18 +809,20 @@ void TWI_MasterWriteHandler()
  */
 void TWI_MasterReadHandler()
 {
+  TWI_Transaction_t* transaction = master_queueHead;
+
   /* Fetch data if bytes to be read. */
-  if (master_bytesRead < master_bytesToRead)
+  if (transaction->bytes_read < transaction->bytes_to_read)
   {
     uint8_t data = TWI0.MDATA;
-    master_readData[master_bytesRead] = data;
-    master_bytesRead++;
+    transaction->read_data[transaction->bytes_read] = data;
+    transaction->bytes_read++;
   }
 
   /* If buffer overflow, issue NACK/STOP and BUFFER_OVERFLOW condition. */
   else
   {
-    if (master_sendStop)
+    if (transaction->send_stop)
     {
       TWI0.MCTRLB = TWI_ACKACT_bm | TWI_MCMD_STOP_gc;
     }
@@ -537,15 +832,11 @@ void TWI_MasterReadHandler()
     }
 
     TWI_MasterTransactionFinished(TWIM_RESULT_BUFFER_OVERFLOW);
-    master_bytesToRead = 0;
     return;
   }
 
-  /* Local variable used in if test to avoid compiler warning. */
-  uint8_t bytesToRead = master_bytesToRead;
-
   /* If more bytes to read, issue ACK and start a byte read. */
-  if (master_bytesRead < bytesToRead)
+  if (transaction->bytes_read < transaction->bytes_to_read)
   {
     TWI0.MCTRLB = TWI_MCMD_RECVTRANS_gc;
   }
@@ -553,7 +844,7 @@ void TWI_MasterReadHandler()
   /* If transaction finished, issue NACK and STOP condition if instructed. */
   else
   {
-    if (master_sendStop)
+    if (transaction->send_stop)
     {
       TWI0.MCTRLB = TWI_ACKACT_bm | TWI_MCMD_STOP_gc;
     }
@@ -568,15 +859,27 @@ void TWI_MasterReadHandler()
 
 /*! \brief TWI transaction finished handler.
  *
- *  Prepares module for new transaction.
+ *  Removes the finished transaction from the queue, starts the next one
+ *  and calls the callback of the finished one.
  *
  *  \param result  The result of the operation.
  */
 void TWI_MasterTransactionFinished(uint8_t result)
 {
-  master_result = result;
-  master_trans_status = TWIM_STATUS_READY;
+  TWI_Transaction_t* transaction = master_queueHead;
+
   twi_mode = TWI_MODE_MASTER;
+  master_queueHead = transaction->next;
+  if (master_queueHead != NULL && !master_recoverPending)
+  {
+    TWI_MasterStart();
+  }
+
+  transaction->result = result;
+  if (transaction->callback != NULL)
+  {
+    transaction->callback(transaction);
+  }
 }
 
 /*! \brief Common TWI slave interrupt service routine.
@@ -669,6 +972,20 @@ void TWI_SlaveAddressMatchHandler()
   slave_trans_status = TWIS_STATUS_BUSY;
   slave_result = TWIS_RESULT_UNKNOWN;
 
+  /* SDATA holds the address that matched, which picks the register map
+   * when the second address or the address mask is in use */
+  uint8_t address = TWI0.SDATA >> 1;
+  slave_matchedAddress = address;
+  slave_map = NULL;
+  for (uint8_t i = 0; i < TWI_SLAVE_REGISTER_MAPS; i++)
+  {
+    if (slave_maps[i] != NULL && slave_maps[i]->address == address)
+    {
+      slave_map = slave_maps[i];
+      break;
+    }
+  }
+
   /* Send ACK, wait for data interrupt */
   TWI0.SCTRLB = TWI_SCMD_RESPONSE_gc;
 
@@ -676,16 +993,20 @@ void TWI_SlaveAddressMatchHandler()
   if (TWI0.SSTATUS & TWI_DIR_bm)
   {
     slave_bytesWritten = 0;
-    /* Call user function  */
-    slave_bytesToWrite = TWI_onSlaveTransmit();
-    twi_mode = TWI_MODE_SLAVE_TRANSMIT;
+    /* Call user function, unless a register map serves the address */
+    if (slave_map == NULL)
+      slave_bytesToWrite = TWI_onSlaveTransmit();
+    twi_slave_mode = TWI_MODE_SLAVE_TRANSMIT;
   }
   /* If Master Write/Slave Read */
   else
   {
     slave_bytesRead = 0;
-    slave_callUserReceive = 1;
-    twi_mode = TWI_MODE_SLAVE_RECEIVE;
+    if (slave_map == NULL)
+      slave_callUserReceive = 1;
+    else
+      slave_mapPointerPending = 1;
+    twi_slave_mode = TWI_MODE_SLAVE_RECEIVE;
   }
 
   /* Data interrupt to follow... */
@@ -713,8 +1034,17 @@ void TWI_SlaveDataHandler()
   /* Enable stop interrupt */
   TWI0.SCTRLA |= (TWI_APIEN_bm | TWI_PIEN_bm);
 
+  /* Register maps are served right here, without calling user code */
+  if (slave_map != NULL)
+  {
+    if (TWI0.SSTATUS & TWI_DIR_bm)
+      TWI_SlaveMapWriteHandler();
+    else
+      TWI_SlaveMapReadHandler();
+  }
+
   /* If Master Read/Slave Write */
-  if (TWI0.SSTATUS & TWI_DIR_bm)
+  else if (TWI0.SSTATUS & TWI_DIR_bm)
   {
     TWI_SlaveWriteHandler();
   }
@@ -789,6 +1119,151 @@ void TWI_SlaveReadHandler()
   }
 }
 
+/*! \brief TWI slave register map write interrupt handler.
+ *
+ *  Sends the register at the register pointer to the master.
+ *
+ */
+static void TWI_SlaveMapWriteHandler(void)
+{
+  TWI_RegisterMap_t *map = slave_map;
+
+  /* If NACK, slave write transaction finished */
+  if ((slave_bytesWritten > 0) && (TWI0.SSTATUS & TWI_RXACK_bm))
+  {
+    TWI0.SCTRLB = TWI_SCMD_COMPTRANS_gc;
+    TWI_SlaveTransactionFinished(TWIS_RESULT_OK);
+  }
+
+  /* If ACK, master expects more data */
+  else
+  {
+    uint8_t pointer = map->pointer;
+    if (pointer < map->count)
+    {
+      TWI0.SDATA = *map->registers[pointer];
+      map->pointer = pointer + 1;
+    }
+    else
+    {
+      TWI0.SDATA = 0xFF;
+    }
+    /* Only used to tell the first byte from the rest, so it can't overflow */
+    slave_bytesWritten = 1;
+
+    /* Send data, wait for data interrupt */
+    TWI0.SCTRLB = TWI_SCMD_RESPONSE_gc;
+  }
+}
+
+/*! \brief TWI slave register map read interrupt handler.
+ *
+ *  The first byte from the master sets the register pointer, the rest are
+ *  written to the registers through their write masks.
+ *
+ */
+static void TWI_SlaveMapReadHandler(void)
+{
+  TWI_RegisterMap_t *map = slave_map;
+  uint8_t data = TWI0.SDATA;
+  uint8_t pointer = map->pointer;
+
+  if (slave_mapPointerPending)
+  {
+    map->pointer = data;
+    slave_mapPointerPending = 0;
+  }
+  else if (pointer < map->count)
+  {
+    uint8_t mask = (map->write_masks != NULL) ? map->write_masks[pointer] : 0;
+    if (mask)
+    {
+      volatile uint8_t *reg = map->registers[pointer];
+      *reg = (*reg & ~mask) | (data & mask);
+    }
+    map->pointer = pointer + 1;
+  }
+  /* Past the last register, send NACK and wait for next START */
+  else
+  {
+    TWI0.SCTRLB = TWI_ACKACT_bm | TWI_SCMD_COMPTRANS_gc;
+    TWI_SlaveTransactionFinished(TWIS_RESULT_BUFFER_OVERFLOW);
+    return;
+  }
+
+  /* Send ACK and wait for data interrupt */
+  TWI0.SCTRLB = TWI_SCMD_RESPONSE_gc;
+}
+
+/*! \brief Serve a slave address from a register map.
+ *
+ *  The map replaces any map already added for the same address, and must
+ *  stay valid until it is removed. The address has to be one the slave
+ *  responds to, through its own address, the second address or the
+ *  address mask passed to TWI_SlaveInit().
+ *
+ *  \param map  The register map.
+ *
+ *  \retval 1 if the map was added, 0 if all TWI_SLAVE_REGISTER_MAPS are taken.
+ */
+uint8_t TWI_SlaveAddRegisterMap(TWI_RegisterMap_t *map)
+{
+  uint8_t added = 0;
+  uint8_t status = SREG;
+  cli();
+  for (uint8_t i = 0; i < TWI_SLAVE_REGISTER_MAPS; i++)
+  {
+    if (slave_maps[i] != NULL && slave_maps[i]->address == map->address)
+    {
+      slave_maps[i] = map;
+      added = 1;
+      break;
+    }
+  }
+  for (uint8_t i = 0; i < TWI_SLAVE_REGISTER_MAPS && !added; i++)
+  {
+    if (slave_maps[i] == NULL)
+    {
+      slave_maps[i] = map;
+      added = 1;
+    }
+  }
+  SREG = status;
+  return added;
+}
+
+/*! \brief Stop serving a slave address from a register map.
+ *
+ *  Transactions to the address go to the user callbacks again.
+ *
+ *  \param address  The 7-bit slave address.
+ */
+void TWI_SlaveRemoveRegisterMap(uint8_t address)
+{
+  uint8_t status = SREG;
+  cli();
+  for (uint8_t i = 0; i < TWI_SLAVE_REGISTER_MAPS; i++)
+  {
+    if (slave_maps[i] != NULL && slave_maps[i]->address == address)
+      slave_maps[i] = NULL;
+  }
+  if (slave_map != NULL && slave_map->address == address)
+    slave_map = NULL;
+  SREG = status;
+}
+
+/*! \brief The slave address of the last address match.
+ *
+ *  Tells which address a master used when the slave responds to more than
+ *  one, for instance from the user callbacks.
+ *
+ *  \retval The 7-bit slave address.
+ */
+uint8_t TWI_SlaveMatchedAddress(void)
+{
+  return slave_matchedAddress;
+}
+
 /*
  * Function twi_attachSlaveRxEvent
  * Desc     sets function called before a slave read operation
@@ -823,7 +1298,8 @@ void TWI_attachSlaveTxEvent(uint8_t (*function)(void), uint8_t* write_data)
 void TWI_SlaveTransactionFinished(uint8_t result)
 {
   TWI0.SCTRLA |= (TWI_APIEN_bm | TWI_PIEN_bm);
-  twi_mode = TWI_MODE_SLAVE;
+  twi_slave_mode = TWI_MODE_SLAVE;
+  slave_map = NULL;
   slave_result = result;
   slave_trans_status = TWIM_STATUS_READY;
 }
@@ -43,8 +43,25 @@ typedef enum __attribute__((packed)) TWIM_RESULT_enum
   TWIM_RESULT_BUS_ERROR = (0x04 << 0),
   TWIM_RESULT_NACK_RECEIVED = (0x05 << 0),
   TWIM_RESULT_FAIL = (0x06 << 0),
+  TWIM_RESULT_ADDRESS_NACK = (0x07 << 0),
+  TWIM_RESULT_TIMEOUT = (0x08 << 0),
 } TWIM_RESULT_t;
 
+/*! Status codes returned by the blocking master functions, same as the
+ *  ones returned by Wire.endTransmission() on other Arduino cores.
+ */
+#define TWI_STATUS_OK 0
+#define TWI_STATUS_DATA_TOO_LONG 1
+#define TWI_STATUS_ADDRESS_NACK 2
+#define TWI_STATUS_DATA_NACK 3
+#define TWI_STATUS_OTHER_ERROR 4
+#define TWI_STATUS_TIMEOUT 5
+
+/*! Number of times a transaction is retried after losing arbitration */
+#ifndef TWI_ARBITRATION_RETRIES
+#define TWI_ARBITRATION_RETRIES 3
+#endif
+
 /* Transaction result enumeration */
 typedef enum __attribute__((packed)) TWIS_RESULT_enum
 {
@@ -69,17 +86,66 @@ typedef enum __attribute__((packed)) TWI_MODE_enum
   TWI_MODE_SLAVE_RECEIVE = 6
 } TWI_MODE_t;
 
+/*! Master transaction.
+ *
+ *  Transactions are queued with TWI_MasterQueue() and run one after the
+ *  other from the master interrupt. The transaction and its buffers are
+ *  owned by the caller and must stay valid until result is no longer
+ *  TWIM_RESULT_UNKNOWN.
+ */
+typedef struct TWI_Transaction_struct
+{
+  uint8_t slave_address;                 /*!< 7-bit slave address */
+  const uint8_t *write_data;             /*!< Data to write */
+  uint16_t bytes_to_write;               /*!< Number of bytes to write */
+  uint8_t *read_data;                    /*!< Buffer for read data */
+  uint16_t bytes_to_read;                /*!< Number of bytes to read */
+  uint8_t send_stop;                     /*!< To send a stop at the end of the transaction or not */
+  void (*callback)(struct TWI_Transaction_struct *transaction); /*!< Called from the interrupt when done, or NULL */
+  volatile uint8_t result;               /*!< TWIM_RESULT_t, TWIM_RESULT_UNKNOWN until done */
+  uint16_t bytes_written;                /*!< Number of bytes written */
+  uint16_t bytes_read;                   /*!< Number of bytes read */
+  uint8_t retries;                       /*!< Number of times arbitration was lost */
+  struct TWI_Transaction_struct *next;   /*!< Next transaction in the queue */
+} TWI_Transaction_t;
+
+/*! Number of slave addresses that can have a register map */
+#ifndef TWI_SLAVE_REGISTER_MAPS
+#define TWI_SLAVE_REGISTER_MAPS 2
+#endif
+
+/*! Slave register map.
+ *
+ *  Serves a block of registers on one slave address entirely from the slave
+ *  interrupt, without calling any user code. The first byte of a master
+ *  write sets the register pointer, and following bytes are written to the
+ *  registers. A master read returns the registers from the register pointer
+ *  and on. The pointer increments after every byte and is kept between
+ *  transactions. Bytes past the last register are NACKed on writes and read
+ *  as 0xFF.
+ */
+typedef struct TWI_RegisterMap_struct
+{
+  uint8_t address;                       /*!< 7-bit slave address served by this map */
+  volatile uint8_t *const *registers;    /*!< Pointer to each register */
+  const uint8_t *write_masks;            /*!< Bits the master may write in each register, NULL for all read-only */
+  uint8_t count;                         /*!< Number of registers */
+  volatile uint8_t pointer;              /*!< Register pointer */
+} TWI_RegisterMap_t;
+
 /*! For adding R/_W bit to address */
 #define ADD_READ_BIT(address) (address | 0x01)
 #define ADD_WRITE_BIT(address) (address & ~0x01)
 
 void TWI_MasterInit(uint32_t frequency);
 void TWI_SlaveInit(uint8_t address, uint8_t receive_broadcast, uint8_t second_address);
+void TWI_EnableDualMode(uint8_t fmp_enable);
 void TWI_Flush(void);
 void TWI_Disable(void);
 TWI_BUSSTATE_t TWI_MasterState(void);
 uint8_t TWI_MasterReady(void);
 void TWI_MasterSetBaud(uint32_t frequency);
+void TWI_MasterSetRiseTime(uint16_t rise_time_ns);
 uint8_t TWI_MasterWrite(uint8_t slave_address,
                         uint8_t *write_data,
                         uint8_t bytes_to_write,
@@ -91,8 +157,16 @@ uint8_t TWI_MasterRead(uint8_t slave_address,
 uint8_t TWI_MasterWriteRead(uint8_t slave_address,
                             uint8_t *write_data,
                             uint8_t bytes_to_write,
+                            uint8_t *read_data,
                             uint8_t bytes_to_read,
                             uint8_t send_stop);
+uint8_t TWI_MasterQueue(TWI_Transaction_t *transaction);
+uint8_t TWI_MasterResultStatus(uint8_t result);
+void TWI_MasterSetTimeout(uint32_t timeout_us, uint8_t reset_with_timeout);
+uint8_t TWI_MasterTimeoutFlag(void);
+void TWI_MasterClearTimeoutFlag(void);
+void TWI_MasterPoll(void);
+void TWI_MasterRecoverBus(void);
 void TWI_MasterInterruptHandler(void);
 void TWI_MasterArbitrationLostBusErrorHandler(void);
 void TWI_MasterWriteHandler(void);
@@ -108,6 +182,9 @@ void TWI_SlaveReadHandler(void);
 void TWI_attachSlaveRxEvent(void (*function)(int), uint8_t *read_data, uint8_t bytes_to_read);
 void TWI_attachSlaveTxEvent(uint8_t (*function)(void), uint8_t *write_data);
 void TWI_SlaveTransactionFinished(uint8_t result);
+uint8_t TWI_SlaveAddRegisterMap(TWI_RegisterMap_t *map);
+void TWI_SlaveRemoveRegisterMap(uint8_t address);
+uint8_t TWI_SlaveMatchedAddress(void);
 /*! TWI master interrupt service routine.
  *
  *  Interrupt service routine for the TWI master. Copy the needed vectors